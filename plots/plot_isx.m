@@ -7,6 +7,26 @@ isx      = [2.50817  3.64819 4.69267 5.44885 6.18487 6.67618 7.68389 8.27339 8.9
 isx_ctx  = [0.822477 1.14437 1.38388 1.45359 1.58161 1.63997 1.72123 1.78588 1.8381  1.86344  1.90882  1.95131  2.00213  2.0462   2.09841  2.14585  2.20748  2.26188  2.40844  2.57478  2.70844  2.8562   3.09105  3.54917  3.98887  4.23458  4.42604  4.96887  5.45148  6.0691  6.30823] ./ 100;
 isx_pure = [0.782533 1.10313 1.38479 1.5666  1.74193 1.88662 2.0304  2.18122 2.32244 2.45817  2.61293  2.75536  2.88607  3.02337  3.16431  3.29464  3.44705  3.58341  3.77253  4.00747  4.18822  4.42332  4.60414  5.71836  6.17659  6.41886  6.55321  7.09729  7.73928  8.2297   8.42772] ./ 100;
 
+% Use the output of scripts/run_isx.sh instead when it is around, with the same
+% scaling as the numbers above (24 cores per node)
+if isfile('isx.jsonl')
+    recs = read_jsonl('isx.jsonl');
+
+    for k = 1:numel(recs)
+        r     = recs{k};
+        nodes = r.pes * r.threads_per_pe / 24;
+        t     = r.iter_avg_ms / 100;
+
+        if r.threads_per_pe == 1
+            isx_pure(nodes - 1) = t;
+        elseif r.pipelining
+            isx_ctx(nodes - 1) = t;
+        else
+            isx(nodes - 1) = t;
+        end
+    end
+end
+
 figure;
 semilogy(n, isx, '--s', n, isx_ctx, '-x', n, isx_pure, '-.o', 'LineWidth', 1);
 pbaspect([1.2 1 1]);
@@ -7,6 +7,25 @@ mandel      = [2.04971e+07 3.37845e+07 3.98733e+07 4.89843e+07 7.10129e+07 8.237
 mandel_ctx  = [2.95886e+07 4.44382e+07 5.85851e+07 7.30589e+07 8.80394e+07 1.02347e+08 1.1594e+08  1.30682e+08 1.43791e+08 1.58447e+08 1.7274e+08  1.85969e+08 1.9892e+08  2.13132e+08 2.25391e+08 2.40299e+08 2.52785e+08 2.66488e+08 2.78906e+08 2.9219e+08  3.06869e+08 3.18661e+08 3.32327e+08 3.44091e+08 3.57525e+08 3.69757e+08 3.82646e+08 3.96179e+08 4.0722e+08  4.35938e+08 4.4504e+08];
 mandel_pure = [2.93944e+07 4.52557e+07 6.03148e+07 7.53723e+07 9.06037e+07 1.05604e+08 1.20668e+08 1.35869e+08 1.50017e+08 1.65502e+08 1.80222e+08 1.94981e+08 2.09855e+08 2.24635e+08 2.39212e+08 2.54297e+08 2.69243e+08 2.83936e+08 2.98711e+08 3.13876e+08 3.27817e+08 3.42658e+08 3.5741e+08  3.7182e+08  3.87435e+08 4.02209e+08 4.17032e+08 4.32289e+08 4.46633e+08 4.61269e+08 4.73974e+08];
 
+% Use the output of scripts/run_mandelbrot.sh instead when it is around (24
+% cores per node)
+if isfile('mandelbrot.jsonl')
+    recs = read_jsonl('mandelbrot.jsonl');
+
+    for k = 1:numel(recs)
+        r     = recs{k};
+        nodes = r.pes * r.threads_per_pe / 24;
+
+        if r.threads_per_pe == 1
+            mandel_pure(nodes - 1) = r.points_per_s;
+        elseif r.pipelining
+            mandel_ctx(nodes - 1) = r.points_per_s;
+        else
+            mandel(nodes - 1) = r.points_per_s;
+        end
+    end
+end
+
 figure;
 plot(n, mandel, '--s', n, mandel_ctx, '-x', n, mandel_pure, '-.o', 'LineWidth', 1);
 pbaspect([1.2 1 1]);
@@ -0,0 +1,18 @@
+function recs = read_jsonl(file)
+% Read the results written with "-f json" (one JSON object per line) into a
+% cell array of structs, lines that are not JSON objects are skipped
+
+recs = {};
+
+fid  = fopen(file, 'r');
+line = fgetl(fid);
+
+while ischar(line)
+    if startsWith(strtrim(line), '{')
+        recs{end + 1} = jsondecode(line); %#ok<AGROW>
+    end
+    line = fgetl(fid);
+end
+
+fclose(fid);
+end
@@ -10,6 +10,9 @@ export N_CORES_NUMA=12
 export SHMEM_SYMMETRIC_SIZE=500M
 export OMP_PROC_BIND=true
 
+# One JSON object per run, see plots/plot_isx.m
+rm -f isx.jsonl
+
 oshcxx -std=c++14 -Wall -Wextra -O2 -march=native -fopenmp isx.cpp -o isx
 
 for NN in $(seq 2 $N_NODES)
@@ -17,9 +20,9 @@ do
     export NNU=$(($NN * $N_NUMAS_NODE))
     export NC=$(($NN * $N_NUMAS_NODE * $N_CORES_NUMA))
 
-    oshrun -n $NC --map-by core:span --rank-by core:span --bind-to core ./isx -i $N_ITERS -w $N_KEYS -t 1 -n -p
-    oshrun -n $NNU --map-by numa:span --bind-to numa ./isx -i $N_ITERS -w $N_KEYS -t $N_CORES_NUMA -n
-    oshrun -n $NNU --map-by numa:span --bind-to numa ./isx -i $N_ITERS -w $N_KEYS -t $N_CORES_NUMA -n -p
+    oshrun -n $NC --map-by core:span --rank-by core:span --bind-to core ./isx -f json -i $N_ITERS -w $N_KEYS -t 1 -n -p >> isx.jsonl
+    oshrun -n $NNU --map-by numa:span --bind-to numa ./isx -f json -i $N_ITERS -w $N_KEYS -t $N_CORES_NUMA -n >> isx.jsonl
+    oshrun -n $NNU --map-by numa:span --bind-to numa ./isx -f json -i $N_ITERS -w $N_KEYS -t $N_CORES_NUMA -n -p >> isx.jsonl
 done
 
 rm isx
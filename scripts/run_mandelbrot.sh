@@ -10,6 +10,9 @@ export N_CORES_NUMA=12
 export SHMEM_SYMMETRIC_SIZE=2500M
 export OMP_PROC_BIND=true
 
+# One JSON object per run, see plots/plot_mandelbrot.m
+rm -f mandelbrot.jsonl
+
 oshcxx -std=c++14 -Wall -Wextra -O3 -march=native -fopenmp mandelbrot.cpp -o man
 
 for NN in $(seq 2 $N_NODES)
@@ -17,9 +20,9 @@ do
     export NNU=$(($NN * $N_NUMAS_NODE))
     export NC=$(($NN * $N_NUMAS_NODE * $N_CORES_NUMA))
 
-    oshrun -n $NC --map-by core:span --rank-by core:span --bind-to core ./man -j $N_JOB_PTS -i $N_PT_ITERS -t 1 -p
-    oshrun -n $NNU --map-by numa:span --bind-to numa ./man -j $N_JOB_PTS -i $N_PT_ITERS -t $N_CORES_NUMA
-    oshrun -n $NNU --map-by numa:span --bind-to numa ./man -j $N_JOB_PTS -i $N_PT_ITERS -t $N_CORES_NUMA -p
+    oshrun -n $NC --map-by core:span --rank-by core:span --bind-to core ./man -f json -j $N_JOB_PTS -i $N_PT_ITERS -t 1 -p >> mandelbrot.jsonl
+    oshrun -n $NNU --map-by numa:span --bind-to numa ./man -f json -j $N_JOB_PTS -i $N_PT_ITERS -t $N_CORES_NUMA >> mandelbrot.jsonl
+    oshrun -n $NNU --map-by numa:span --bind-to numa ./man -f json -j $N_JOB_PTS -i $N_PT_ITERS -t $N_CORES_NUMA -p >> mandelbrot.jsonl
 done
 
 rm man
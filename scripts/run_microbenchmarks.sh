@@ -4,64 +4,73 @@
 # using all 48 cores on the two nodes, since they both use very small message sizes
 # and so NUMA effect can be ignored
 #
-# To select different microbenchmarks, simply comment/uncomment the corresponding
-# lines in the main function of microbenchmarks_mt.cpp & microbenchmarks_pure.cpp
+# To select different microbenchmarks, pass their names to --bench (see --list), e.g.
+# "--bench put_nbi,amo_fetch --sizes 1:1M", and pick the execution model with --model
+# (pure, threads, ctx or shared_ctx), the pure model needs n_nodes * n_workers PEs
+#
+# All benchmarks but "pattern" need exactly 2 nodes, "pattern" runs on any number of
+# them and --pattern picks the destinations, e.g. a ring of 8 nodes w/ 12 threads each:
+# oshrun -n 8 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b pattern -P ring 12
 #
 # put/get tests use similar commands to run, but the hybrid versions are bound to a
 # single NUMA domain and only use up to 12 threads, and the pure versions use up to
 # 12 processes per node (also in the same socket)
 #
 # Example for running put test w/ 12 cores per node:
-# oshrun -n 2 --map-by node:span --bind-to numa ./a.out 12 >> put_ctx
-# oshrun -n 24 --map-by node:span --rank-by core:span --bind-to core ./a.out 12 >> put_pure
+# oshrun -n 2 --map-by node:span --bind-to numa ./a.out -f json -m ctx -S -b put 12 >> put_ctx.jsonl
+# oshrun -n 24 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b put 12 >> put_pure.jsonl
+#
+# The ping-pong benchmarks are all in pingpong.cpp, --transport picks how the ball is
+# sent (see --list) and --model works the same way, e.g. for the AMO ping-pong:
+# oshcxx -std=c++14 -Wall -Wextra -fopenmp -march=native -O2 pingpong.cpp -o pingpong
+# oshrun -n 2 --map-by node:span --bind-to none ./pingpong -f json -m ctx -x fadd -s 4 12 >> pp_atomic_ctx.jsonl
 
+# All the runs write JSON lines (-f json), one object per result with the whole
+# configuration of the run, drop "-f json" to get the tables back
+#
 # This is super important for UCX
 export OMP_PROC_BIND=true
 
-oshcxx -std=c++14 -Wall -Wextra -fopenmp -march=native -O2 microbenchmarks_mt.cpp
-
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 1 > amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 2 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 4 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 6 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 8 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 10 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 12 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 14 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 16 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 18 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 20 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 22 >> amo_fetch
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 24 >> amo_fetch
-
-oshcxx -std=c++14 -Wall -Wextra -fopenmp -march=native -O2 -DUSE_CTX microbenchmarks_mt.cpp
+oshcxx -std=c++14 -Wall -Wextra -fopenmp -march=native -O2 microbenchmarks.cpp
 
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 1 > amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 2 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 4 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 6 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 8 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 10 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 12 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 14 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 16 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 18 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 20 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 22 >> amo_fetch_ctx
-oshrun -n 2 --map-by node:span --bind-to none ./a.out 24 >> amo_fetch_ctx
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 1 > amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 2 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 4 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 6 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 8 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 10 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 12 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 14 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 16 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 18 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 20 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 22 >> amo_fetch.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m threads -S -b amo_fetch 24 >> amo_fetch.jsonl
 
-oshcxx -std=c++14 -Wall -Wextra -march=native -O2 microbenchmarks_pure.cpp
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 1 > amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 2 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 4 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 6 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 8 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 10 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 12 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 14 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 16 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 18 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 20 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 22 >> amo_fetch_ctx.jsonl
+oshrun -n 2 --map-by node:span --bind-to none ./a.out -f json -m ctx -S -b amo_fetch 24 >> amo_fetch_ctx.jsonl
 
-oshrun -n 2 --map-by node:span --rank-by core:span --bind-to core ./a.out 1 > amo_fetch_pure
-oshrun -n 4 --map-by node:span --rank-by core:span --bind-to core ./a.out 2 >> amo_fetch_pure
-oshrun -n 8 --map-by node:span --rank-by core:span --bind-to core ./a.out 4 >> amo_fetch_pure
-oshrun -n 12 --map-by node:span --rank-by core:span --bind-to core ./a.out 6 >> amo_fetch_pure
-oshrun -n 16 --map-by node:span --rank-by core:span --bind-to core ./a.out 8 >> amo_fetch_pure
-oshrun -n 20 --map-by node:span --rank-by core:span --bind-to core ./a.out 10 >> amo_fetch_pure
-oshrun -n 24 --map-by node:span --rank-by core:span --bind-to core ./a.out 12 >> amo_fetch_pure
-oshrun -n 28 --map-by node:span --rank-by core:span --bind-to core ./a.out 14 >> amo_fetch_pure
-oshrun -n 32 --map-by node:span --rank-by core:span --bind-to core ./a.out 16 >> amo_fetch_pure
-oshrun -n 36 --map-by node:span --rank-by core:span --bind-to core ./a.out 18 >> amo_fetch_pure
-oshrun -n 40 --map-by node:span --rank-by core:span --bind-to core ./a.out 20 >> amo_fetch_pure
-oshrun -n 44 --map-by node:span --rank-by core:span --bind-to core ./a.out 22 >> amo_fetch_pure
-oshrun -n 48 --map-by node:span --rank-by core:span --bind-to core ./a.out 24 >> amo_fetch_pure
+oshrun -n 2 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 1 > amo_fetch_pure.jsonl
+oshrun -n 4 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 2 >> amo_fetch_pure.jsonl
+oshrun -n 8 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 4 >> amo_fetch_pure.jsonl
+oshrun -n 12 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 6 >> amo_fetch_pure.jsonl
+oshrun -n 16 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 8 >> amo_fetch_pure.jsonl
+oshrun -n 20 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 10 >> amo_fetch_pure.jsonl
+oshrun -n 24 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 12 >> amo_fetch_pure.jsonl
+oshrun -n 28 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 14 >> amo_fetch_pure.jsonl
+oshrun -n 32 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 16 >> amo_fetch_pure.jsonl
+oshrun -n 36 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 18 >> amo_fetch_pure.jsonl
+oshrun -n 40 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 20 >> amo_fetch_pure.jsonl
+oshrun -n 44 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 22 >> amo_fetch_pure.jsonl
+oshrun -n 48 --map-by node:span --rank-by core:span --bind-to core ./a.out -f json -m pure -S -b amo_fetch 24 >> amo_fetch_pure.jsonl
@@ -0,0 +1,298 @@
+// Execution models of the microbenchmarks
+//
+// Every node has the same number of workers. Most benchmarks run between two
+// nodes, where worker i of one node talks to worker i of the other node, but
+// the models work with any number of nodes. What a worker is depends on the
+// execution model:
+//   pure_model:                       one PE per worker, no threads
+//   thread_model<ctx_kind::Default>:  one PE per node, workers are OpenMP threads
+//                                     that share the default context
+//   thread_model<ctx_kind::Private>:  same, but every thread creates a private context
+//   thread_model<ctx_kind::Shared>:   same, but all the threads of a PE share one
+//                                     (non-private) context
+//
+// The benchmarks are templated on the model, so all the models run exactly the
+// same code and only differ in the way the workers are created, synchronized
+// and in the context they use.
+#pragma once
+
+#include <cstdint>
+
+#include <shmem.h>
+#include <omp.h>
+
+
+// shmem_ctx_t may be a pointer to an unnamed struct, which has no linkage, so
+// the types that hold one are kept local to the program that includes this
+namespace {
+
+
+// Identity of a worker, passed to the body of every benchmark
+struct worker {
+    // Thread ID inside this PE, always 0 in the pure model
+    size_t tid;
+    // Which node this worker belongs to, and its rank inside the node
+    size_t node, rank;
+    // Index of the worker in [0, n_nodes * n_workers), for publishing statistics
+    size_t idx;
+    // The PE running the worker with the same rank on the partner node, nodes
+    // are paired as (0, 1), (2, 3), ... and the last one of an odd count is
+    // its own partner
+    size_t peer_pe;
+    // The PE hosting the AMO target shared by all workers of this node, which
+    // is the first PE of the partner node
+    size_t amo_pe;
+    // The worker that collects and prints the statistics of both nodes
+    bool is_reporter;
+    // The context used for all the communication of this worker
+    shmem_ctx_t ctx;
+};
+
+
+// Index of the node paired with node in [0, n_nodes)
+inline size_t partner_node(const size_t node, const size_t n_nodes)
+{
+    return ((node ^ 1) < n_nodes) ? (node ^ 1) : node;
+}
+
+
+class pure_model {
+private:
+    const size_t n_workers;
+    const size_t nodes;
+
+    // Work array for barriers among the PEs of a node
+    static long* psync_node()
+    {
+        static long psync[SHMEM_BARRIER_SYNC_SIZE];
+        return psync;
+    }
+
+public:
+    // n_workers is the number of workers (PEs) per node, the number of nodes
+    // follows from the number of PEs
+    explicit pure_model(const size_t _n_workers)
+        : n_workers(_n_workers), nodes(shmem_n_pes() / _n_workers)
+    {
+        for (int i = 0; i < SHMEM_BARRIER_SYNC_SIZE; i++) {
+            psync_node()[i] = SHMEM_SYNC_VALUE;
+        }
+
+        shmem_barrier_all();
+    }
+
+    static const char* name()
+    {
+        return "pure";
+    }
+
+    static int thread_level(const size_t)
+    {
+        return SHMEM_THREAD_SINGLE;
+    }
+
+    // Whether the PEs can be split into nodes of n_workers PEs each
+    bool valid() const
+    {
+        return (size_t(shmem_n_pes()) == nodes * n_workers);
+    }
+
+    size_t workers_per_node() const
+    {
+        return n_workers;
+    }
+
+    size_t workers_per_pe() const
+    {
+        return 1;
+    }
+
+    size_t n_nodes() const
+    {
+        return nodes;
+    }
+
+    // The PE running the worker with the given rank on the given node
+    size_t pe_of(const size_t node, const size_t rank) const
+    {
+        return node * n_workers + rank;
+    }
+
+    size_t report_pe() const
+    {
+        return pe_of(1, 0);
+    }
+
+    // Run f(worker&) on the only worker of this PE
+    template <typename F>
+    void run(F&& f)
+    {
+        const size_t mype = shmem_my_pe();
+
+        worker w;
+        w.tid         = 0;
+        w.node        = mype / n_workers;
+        w.rank        = mype % n_workers;
+        w.idx         = mype;
+        w.peer_pe     = pe_of(partner_node(w.node, nodes), w.rank);
+        w.amo_pe      = pe_of(partner_node(w.node, nodes), 0);
+        w.is_reporter = (mype == report_pe());
+        w.ctx         = SHMEM_CTX_DEFAULT;
+
+        f(w);
+    }
+
+    // All the workers on all the nodes
+    void barrier()
+    {
+        shmem_barrier_all();
+    }
+
+    // All the workers on the node of w
+    void node_barrier(const worker& w)
+    {
+        shmem_barrier(w.node * n_workers, 0, n_workers, psync_node());
+    }
+
+    // Store v in slots[w.idx] on the reporter, completed by the next barrier
+    void publish(const worker& w, double* slots, const double v)
+    {
+        shmem_double_p(&slots[w.idx], v, report_pe());
+    }
+};
+
+
+enum class ctx_kind {
+    Default,
+    Private,
+    Shared
+};
+
+
+template <ctx_kind K>
+class thread_model {
+private:
+    const size_t n_workers;
+
+public:
+    // n_workers is the number of workers (threads) per node, every PE is a node
+    explicit thread_model(const size_t _n_workers) : n_workers(_n_workers) {}
+
+    static const char* name()
+    {
+        switch (K) {
+            case ctx_kind::Private:
+                return "ctx";
+            case ctx_kind::Shared:
+                return "shared_ctx";
+            default:
+                return "threads";
+        }
+    }
+
+    static int thread_level(const size_t n_threads)
+    {
+        return (n_threads == 1) ? SHMEM_THREAD_FUNNELED : SHMEM_THREAD_MULTIPLE;
+    }
+
+    bool valid() const
+    {
+        return true;
+    }
+
+    size_t workers_per_node() const
+    {
+        return n_workers;
+    }
+
+    size_t workers_per_pe() const
+    {
+        return n_workers;
+    }
+
+    size_t n_nodes() const
+    {
+        return shmem_n_pes();
+    }
+
+    size_t pe_of(const size_t node, const size_t) const
+    {
+        return node;
+    }
+
+    size_t report_pe() const
+    {
+        return 1;
+    }
+
+    // Run f(worker&) on every thread of this PE
+    template <typename F>
+    void run(F&& f)
+    {
+        const size_t mype    = shmem_my_pe();
+        const size_t n       = n_workers;
+        const size_t partner = partner_node(mype, n_nodes());
+
+        shmem_ctx_t shared_ctx = SHMEM_CTX_DEFAULT;
+
+        if (K == ctx_kind::Shared) {
+            shmem_ctx_create(0, &shared_ctx);
+            shmem_ctx_quiet(shared_ctx);
+        }
+
+        #pragma omp parallel num_threads(n)                             \
+                             default(none)                              \
+                             firstprivate(mype, n, partner, shared_ctx) \
+                             shared(f)
+        {
+            worker w;
+            w.tid         = omp_get_thread_num();
+            w.node        = mype;
+            w.rank        = w.tid;
+            w.idx         = mype * n + w.tid;
+            w.peer_pe     = partner;
+            w.amo_pe      = partner;
+            w.is_reporter = (mype == 1) && (w.tid == 0);
+
+            if (K == ctx_kind::Private) {
+                shmem_ctx_create(SHMEM_CTX_PRIVATE, &w.ctx);
+                shmem_ctx_quiet(w.ctx);
+            } else {
+                w.ctx = shared_ctx;
+            }
+
+            f(w);
+
+            if (K == ctx_kind::Private) {
+                shmem_ctx_destroy(w.ctx);
+            }
+        }
+
+        if (K == ctx_kind::Shared) {
+            shmem_ctx_destroy(shared_ctx);
+        }
+    }
+
+    // All the workers on all the nodes
+    void barrier()
+    {
+        #pragma omp barrier
+        #pragma omp master
+        shmem_barrier_all();
+        #pragma omp barrier
+    }
+
+    // All the workers on the node of w
+    void node_barrier(const worker&)
+    {
+        #pragma omp barrier
+    }
+
+    // Store v in slots[w.idx] on the reporter, completed by the next barrier
+    void publish(const worker& w, double* slots, const double v)
+    {
+        shmem_double_p(&slots[w.idx], v, report_pe());
+    }
+};
+
+} // namespace
@@ -54,13 +54,15 @@
 #include <algorithm>
 #include <iostream>
 #include <cstdint>
-#include <chrono>
 #include <cmath>
 
 #include <getopt.h>
 #include <shmem.h>
 #include <omp.h>
 
+#include "reporter.hpp"
+#include "timer.hpp"
+
 
 #ifndef USE_DOUBLE
     #define USE_DOUBLE 0
@@ -74,6 +76,9 @@ real_t res_pe, res_tot;
 real_t pWrk[SHMEM_REDUCE_MIN_WRKDATA_SIZE];
 long pSync[SHMEM_REDUCE_SYNC_SIZE];
 
+// Time of every thread, gathered on PE 0
+double* thread_t;
+
 
 // Identify the six facets of a sub-domain
 enum class facet_t : int {
@@ -139,6 +144,7 @@ struct params_t {
     real_t K, ds, dt, dsl_x, dsl_y, dsl_z, cnv_tol;
     // We use a cubic mesh
     size_t mesh_len, max_iter, n_threads;
+    reporter::format fmt;
     // Store information of the six facets in the sub-domain
     // Determined by the topology of the PEs, won't change during the simulation
     facet_info fis[int(facet_t::LAST)];
@@ -428,14 +434,15 @@ void print_help(const params_t& pr)
               << "    -T <tol>  Convergence tolerance (default: " << pr.cnv_tol << ")\n"
               << "    -I <iter> Maximum number of iterations (default: " << pr.max_iter << ")\n"
               << "    -M <len>  Side length of the mesh (default: " << pr.mesh_len << ")\n"
-              << "    -t <num>  Number of threads per PE (default: " << pr.n_threads << ")\n";
+              << "    -t <num>  Number of threads per PE (default: " << pr.n_threads << ")\n"
+              << "    -f <fmt>  Output format, table, json or csv (default: table)\n";
 }
 
 
 bool parse_args(int argc, char** argv, params_t& pr)
 {
     int c;
-    while ((c = getopt(argc, argv, "x:y:z:T:I:M:t:")) != -1) {
+    while ((c = getopt(argc, argv, "x:y:z:T:I:M:t:f:")) != -1) {
         switch (c) {
             case 'x':
                 pr.nsd_x = std::atoi(optarg);
@@ -458,6 +465,12 @@ bool parse_args(int argc, char** argv, params_t& pr)
             case 't':
                 pr.n_threads = std::atoi(optarg);
                 break;
+            case 'f':
+                if (!reporter::parse_format(optarg, pr.fmt)) {
+                    print_help(pr);
+                    return true;
+                }
+                break;
             default:
                 print_help(pr);
                 return true;
@@ -809,6 +822,7 @@ int main(int argc, char** argv)
     pr.max_iter  = 500;
     pr.mesh_len  = 3 * 256;
     pr.n_threads = 1;
+    pr.fmt       = reporter::format::Table;
 
     if (parse_args(argc, argv, pr)) {
         return 1;
@@ -822,6 +836,9 @@ int main(int argc, char** argv)
         tl = SHMEM_THREAD_MULTIPLE;
     }
 
+    timer::init();
+    reporter::init("halo3d", pr.fmt);
+
     shmem_init_thread(tl, &tl_supported);
 
     if (tl != tl_supported) {
@@ -857,15 +874,32 @@ int main(int argc, char** argv)
     res_pe      = 0.0;
     double T    = 0.0;
 
+    thread_t = (double*)shmem_malloc(pr.npes * pr.n_threads * sizeof(double));
+
+    reporter::set("pes", pr.npes);
+    reporter::set("threads_per_pe", pr.n_threads);
+    reporter::set("sub_domains_x", pr.nsd_x);
+    reporter::set("sub_domains_y", pr.nsd_y);
+    reporter::set("sub_domains_z", pr.nsd_z);
+    reporter::set("mesh_len", pr.mesh_len);
+    reporter::set("iters", pr.max_iter);
+#ifdef USE_CTX
+    reporter::set("ctx", true);
+#else
+    reporter::set("ctx", false);
+#endif
+    reporter::set("double", USE_DOUBLE != 0);
+    reporter::set("timer", timer::source());
+
     if (pr.mype == 0) {
-        std::cout << "3D halo exchange benchmark: sub-domain mesh "
-                  << pr.npt_x << " x " << pr.npt_y << " x " << pr.npt_z
-                  << ", ds = " << pr.ds << ", dt = " << pr.dt << '\n';
+        reporter::text() << "3D halo exchange benchmark: sub-domain mesh "
+                         << pr.npt_x << " x " << pr.npt_y << " x " << pr.npt_z
+                         << ", ds = " << pr.ds << ", dt = " << pr.dt << '\n';
     }
 
     #pragma omp parallel num_threads(pr.n_threads) \
                          default(none) \
-                         shared(pr, res_pe, res_tot, T, pWrk, pSync)
+                         shared(pr, res_pe, res_tot, T, pWrk, pSync, thread_t)
     {
         th_comm_t tc;
         init_th_comm(pr, tc);
@@ -875,7 +909,7 @@ int main(int argc, char** argv)
         shmem_barrier_all();
         #pragma omp barrier
 
-        const auto t_start = std::chrono::steady_clock::now();
+        const auto t_start = timer::now();
 
         for (size_t i = 0; i < pr.max_iter; i++) {
             // Each thread send the facet(s) that it is responsible for
@@ -899,9 +933,11 @@ int main(int argc, char** argv)
             #pragma omp barrier
         }
 
-        const auto t_end = std::chrono::steady_clock::now();
+        const auto t_end = timer::now();
+
+        T = timer::s(t_end - t_start);
 
-        T = std::chrono::duration<double>(t_end - t_start).count();
+        shmem_double_p(&thread_t[pr.mype * pr.n_threads + tc.tid], timer::s(t_end - t_start), 0);
 
         #ifdef USE_CTX
         for (size_t f = 0; f < tc.n_fcs; f++) {
@@ -910,10 +946,18 @@ int main(int argc, char** argv)
         #endif
     }
 
+    shmem_barrier_all();
+
     if (pr.mype == 0) {
-        std::cout << "Time elapsed: " << T << " seconds" << '\n';
+        record r;
+        r.add("time_s", T, 6)
+         .add("iter_avg_ms", 1000.0 * T / pr.max_iter)
+         .add("thread_s", std::vector<double>(thread_t, thread_t + pr.npes * pr.n_threads));
+        reporter::emit(r);
     }
 
+    shmem_free(thread_t);
+
     cleanup_params(pr);
 
     shmem_finalize();
@@ -0,0 +1,116 @@
+// Log-bucketed latency histogram in the style of HdrHistogram
+//
+// Values (nanoseconds) below 2^SUB_BITS get one bucket each, larger values are
+// split into power-of-two ranges, each of them divided into 2^SUB_BITS linear
+// sub-buckets, so the relative error of a percentile is below 2^-SUB_BITS
+// (~3%). Recording a value is a count-leading-zeros and an increment.
+//
+// The class is trivially copyable, so a histogram can be shipped to another PE
+// with a plain putmem and merged there.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+
+class histogram {
+public:
+    static const int SUB_BITS = 5;
+    static const uint64_t SUB_BUCKETS = 1UL << SUB_BITS;
+    static const size_t N_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    void clear()
+    {
+        std::memset(counts, 0, sizeof(counts));
+        n     = 0;
+        max_v = 0;
+    }
+
+    void record(const uint64_t v)
+    {
+        counts[index(v)]++;
+        n++;
+
+        if (v > max_v) {
+            max_v = v;
+        }
+    }
+
+    void merge(const histogram& other)
+    {
+        for (size_t i = 0; i < N_BUCKETS; i++) {
+            counts[i] += other.counts[i];
+        }
+
+        n += other.n;
+
+        if (other.max_v > max_v) {
+            max_v = other.max_v;
+        }
+    }
+
+    uint64_t count() const
+    {
+        return n;
+    }
+
+    uint64_t max() const
+    {
+        return max_v;
+    }
+
+    // Smallest bucket bound that is >= the p-th fraction (0 < p <= 1) of the
+    // recorded values, never larger than the exact maximum
+    uint64_t percentile(const double p) const
+    {
+        if (n == 0) {
+            return 0;
+        }
+
+        uint64_t rank = uint64_t(p * n + 0.5);
+        if (rank == 0) {
+            rank = 1;
+        }
+
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < N_BUCKETS; i++) {
+            seen += counts[i];
+
+            if (seen >= rank) {
+                const uint64_t upper = highest(i);
+                return (upper < max_v) ? upper : max_v;
+            }
+        }
+
+        return max_v;
+    }
+
+private:
+    uint64_t counts[N_BUCKETS];
+    uint64_t n, max_v;
+
+    static size_t index(const uint64_t v)
+    {
+        if (v < SUB_BUCKETS) {
+            return v;
+        }
+
+        const int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+
+        return (shift + 1) * SUB_BUCKETS + ((v >> shift) - SUB_BUCKETS);
+    }
+
+    // The largest value that falls into bucket i
+    static uint64_t highest(const size_t i)
+    {
+        if (i < SUB_BUCKETS) {
+            return i;
+        }
+
+        const int shift = i / SUB_BUCKETS - 1;
+        const uint64_t sub = i % SUB_BUCKETS + SUB_BUCKETS;
+
+        return ((sub + 1) << shift) - 1;
+    }
+};
@@ -4,40 +4,210 @@
 #include <cstdlib>
 #include <limits>
 #include <memory>
+#include <numeric>
 #include <vector>
 #include <random>
 #include <cmath>
-#include <ctime>
+#include <string>
 
 #include <omp.h>
 #include <shmem.h>
 #include <getopt.h>
 #include <unistd.h>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "reporter.hpp"
+#include "timer.hpp"
+#include "trace.hpp"
+
 
 using key_type = uint32_t;
 
 const key_type MAX_KEY = std::numeric_limits<key_type>::max() / 4;
 
-// Three types of all-to-all communication schedules:
+// The local sort uses 8-bit digits, so the counters of a pass fit in 1 KB
+#define RADIX_BITS 8
+#define RADIX (1U << RADIX_BITS)
+#define MAX_PASSES ((sizeof(key_type) * 8 + RADIX_BITS - 1) / RADIX_BITS)
+
+// Buckets whose range is at most this wide are counting-sorted, the table of
+// counters (256 KB) still fits in L2
+#define COUNT_SORT_MAX_WIDTH (1UL << 16)
+
+// Six types of all-to-all communication schedules:
 //   Round robin: at step i, every PE send data to the PE that is i PEs away
 //   Incast: at step i, every PE send data to PE i
 //   Random: at step i, every PE send data to a random PE
+//   Hierarchical: the keys are gathered by node, sent in one message per pair
+//                 of nodes and scattered on the destination node, see
+//                 hier_gather, hier_send and hier_scatter
+//   Bruck: log2(npes) rounds of messages that carry the keys for many PEs,
+//          forwarded on the way, see bruck_exchange
+//   Pairwise: at step i, every PE send data to the PE whose ID is its own
+//             XOR i, so the PEs exchange in pairs
 enum class Sched {
     RoundRobin,
     Incast,
-    Random
+    Random,
+    Hierarchical,
+    Bruck,
+    Pairwise
+};
+
+// Distributions of the keys, the skewed ones put most of the keys in a few
+// buckets unless the bounds of the buckets come from splitters:
+//   Uniform: all of [0, MAX_KEY]
+//   Zipf: key k with probability ~ (k + 1)^-ZIPF_S
+//   Gaussian: centered in the range, with a standard deviation of
+//             MAX_KEY / GAUSS_SIGMA_DIV, clipped to the range
+//   HotKey: HOT_FRACTION of the keys are one of HOT_KEYS values spread over
+//           the range, the others are uniform
+enum class Dist {
+    Uniform,
+    Zipf,
+    Gaussian,
+    HotKey
+};
+
+#define ZIPF_S 0.8
+#define GAUSS_SIGMA_DIV 8
+#define HOT_KEYS 64
+#define HOT_FRACTION 0.25
+
+const char* dist_name(const Dist d)
+{
+    switch (d) {
+        case Dist::Zipf:
+            return "zipf";
+        case Dist::Gaussian:
+            return "gaussian";
+        case Dist::HotKey:
+            return "hotkey";
+        default:
+            return "uniform";
+    }
+}
+
+// Returns false if the name of the distribution is unknown
+bool parse_dist(const char* name, Dist& d)
+{
+    for (const Dist c : {Dist::Uniform, Dist::Zipf, Dist::Gaussian, Dist::HotKey}) {
+        if (std::string(name) == dist_name(c)) {
+            d = c;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// With splitters, every thread samples this many of its keys, so a bucket
+// bound is picked out of this many samples per bucket
+#define SAMPLES_PER_THREAD 256
+
+// When the results of the iterations are checked
+enum class Verify {
+    None,
+    Last,
+    Every
+};
+
+const char* verify_name(const Verify v)
+{
+    switch (v) {
+        case Verify::None:
+            return "none";
+        case Verify::Last:
+            return "last";
+        default:
+            return "every";
+    }
+}
+
+// How the keys of the flat schedules go on the wire, relative to the lower
+// bound of their bucket:
+//   None: as they are
+//   Bits: packed with as many bits as the width of the bucket needs
+//   Delta: sorted, and the gaps between consecutive keys packed with as many
+//          bits as the largest gap needs
+// An encoded bucket is sent as a record, see encode_record, which the
+// receiver decodes into its bucket after the exchange
+enum class Encode {
+    None,
+    Bits,
+    Delta
 };
 
+const char* encode_name(const Encode e)
+{
+    switch (e) {
+        case Encode::Bits:
+            return "bits";
+        case Encode::Delta:
+            return "delta";
+        default:
+            return "none";
+    }
+}
+
+// The automatic choice picks Bruck when a thread sends fewer bytes than this
+// to every PE, and the pairwise exchange otherwise
+#define BRUCK_MAX_BYTES 2048
+
+// The header and the padding word of an encoded record
+#define RECORD_EXTRA_WORDS 3
+
+const char* sched_name(const Sched s)
+{
+    switch (s) {
+        case Sched::RoundRobin:
+            return "round_robin";
+        case Sched::Incast:
+            return "incast";
+        case Sched::Hierarchical:
+            return "hierarchical";
+        case Sched::Bruck:
+            return "bruck";
+        case Sched::Pairwise:
+            return "pairwise";
+        default:
+            return "random";
+    }
+}
+
 struct params_t {
     size_t iters, n_threads;
     bool use_ctx, use_nbi, use_pipelining;
+    // Rank the keys of the buckets after the exchange, with SIMD histograms
+    bool use_sort, use_simd;
+    // Generate new keys in every iteration, overlapped with the exchange
+    bool use_regen;
+    // Reserve the receive slots with all-to-all collectives, not fetch-adds
+    bool use_a2a_offsets;
     Sched comm;
+    // Pick comm between Bruck and Pairwise from the message size
+    bool auto_comm;
+    Dist dist;
+    // Pick the bounds of the buckets from a sample of the keys
+    bool use_splitters;
+    Verify verify;
+    Encode encode;
+    reporter::format fmt;
+
+    // Nodes of the hierarchical schedule, made of consecutive PEs
+    size_t pes_per_node, n_nodes;
 
     // The last three depend on npes & n_threads
     // bucket_width is the length of the range of a bucket
     size_t n_keys, n_keys_th, n_buckets, bucket_width;
 
+    // Bucket b holds the keys in [bounds[b], bounds[b + 1]), these are
+    // multiples of bucket_width unless they come from splitters
+    std::vector<key_type> bounds;
+
     // If the RNG is good, the number of keys that end up in each bucket
     // should be pretty close to n_keys_th, for a large number of keys
     // For fewer number of keys, increase the size of the buckets in case
@@ -51,19 +221,84 @@ struct params_t {
     // numbers of keys in the bucket when this stage is finished
     size_t* recv_offsets;
 
-    // Store the numbers of received keys for each thread, for verification
-    size_t* n_recv_keys;
+    // For verification: the numbers of keys that the threads of this PE sent
+    // to every bucket, one row per thread, their sums over the threads and
+    // over all the PEs, and the work array of that sum
+    std::vector<long> sent_rows;
+    long *sent_keys, *total_sent_keys, *pWrk_verify;
+
+    // Buffers of the collective offset reservation, one block of n_threads^2
+    // entries per PE, see reserve_offsets
+    size_t *a2a_counts, *a2a_counts_in, *a2a_offsets, *a2a_offsets_in;
+
+    // Staging of the hierarchical schedule: the bucket sizes of all the
+    // threads, and the messages between nodes, sent from stage_out and
+    // received in stage_in, one slot of stage_slot_bytes per peer node
+    size_t* node_counts;
+    char *stage_out, *stage_in;
+    size_t stage_slot_bytes;
+
+    // Bruck: one receive slot of bruck_slot_bytes per thread and round, and a
+    // flag for each, set to the iteration number when the message is there
+    size_t bruck_rounds, bruck_slot_bytes;
+    char* bruck_in;
+    uint64_t* bruck_flags;
+
+    // Encoded exchange: the records sent to every thread of this PE land in
+    // its wire buffer of wire_len words, wire_offsets are the first words
+    // that are not filled yet, like recv_offsets
+    std::vector<uint32_t*> wire;
+    size_t* wire_offsets;
+    size_t wire_len;
+
+    // The samples of the threads of this PE, and of all the PEs
+    key_type *samples, *all_samples;
+
+    // The number of keys of every bucket in the last iteration, and the bytes
+    // of keys that every thread sent in it, on PE 0
+    size_t *bucket_keys, *wire_bytes;
+
+    // Trace the communication of every thread into traces, and dump them to
+    // <trace_prefix>.<pe>.bin, if the prefix isn't empty
+    std::string trace_prefix;
+    std::vector<trace_ring> traces;
 };
 
-// For the verification stage
-size_t total_exchanged_keys;
+// For collecting timing data, every thread keeps its times of every timed
+// iteration in its own rows of T_iters, one row of T_stride per kind of time,
+// padded to whole cache lines, at [(gtid * N_TIMES + kind) * T_stride], and the
+// rows of all the threads are gathered on PE 0 at the end
+// The cycle is the whole send stage, including the generation and bucketing
+// of the keys when they are regenerated, the comm only counts the communication
+enum {
+    TIME_COMM,
+    TIME_CYCLE,
+    TIME_SORT,
+    N_TIMES
+};
 
-// For collecting timing data
-double T_pe, T_sum;
+double* T_iters;
+size_t T_stride;
+// Time to pick the splitters, the largest of all the PEs
+double T_sample_pe, T_sample_max;
+// The time 0 of the traces
+timer::ticks trace_origin;
 
 long pSync[SHMEM_REDUCE_SYNC_SIZE];
 double pWrk[SHMEM_REDUCE_MIN_WRKDATA_SIZE];
 
+// The two all-to-alls of an offset reservation alternate between these
+long pSync_a2a[2][SHMEM_ALLTOALL_SYNC_SIZE];
+
+// For the barriers among the PEs of a node
+long pSync_node[SHMEM_BARRIER_SYNC_SIZE];
+
+// For gathering the samples of the splitters
+long pSync_collect[SHMEM_COLLECT_SYNC_SIZE];
+
+// For the sum of the verification, every iteration starts with a barrier
+long pSync_verify[SHMEM_REDUCE_SYNC_SIZE];
+
 
 void print_help(const params_t& pr)
 {
@@ -80,7 +315,39 @@ void print_help(const params_t& pr)
               << "    -r <SCHEDULE>  Specify the scheduling of the all-to-all key exchange\n"
               << "                       SCHEDULE = 0: Round Robin (default)\n"
               << "                       SCHEDULE = 1: Incast\n"
-              << "                       SCHEDULE = 2: Random\n";
+              << "                       SCHEDULE = 2: Random\n"
+              << "                       SCHEDULE = 3: Hierarchical, one message per pair of nodes\n"
+              << "                       SCHEDULE = 4: Bruck, log2(npes) rounds\n"
+              << "                       SCHEDULE = 5: Pairwise XOR exchange\n"
+              << "                       SCHEDULE = 6: Bruck below " << BRUCK_MAX_BYTES << " bytes per PE and thread,\n"
+              << "                                     pairwise otherwise\n"
+              << "    -l <pes>       PEs per node of the hierarchical schedule (default: all the\n"
+              << "                   PEs that shmem_ptr can reach)\n"
+              << "    -d <dist>      Distribution of the keys, uniform, zipf, gaussian or hotkey\n"
+              << "                   (default: " << dist_name(pr.dist) << ")\n"
+              << "    -b             Balance the buckets with splitters picked from a sample of the\n"
+              << "                   keys, gathered on all the PEs (default: disabled)\n"
+              << "    -a             Reserve the receive slots with two all-to-all collectives\n"
+              << "                   instead of one fetch-add per bucket, not used by the\n"
+              << "                   hierarchical schedule (default: disabled)\n"
+              << "    -g             Regenerate the keys in every iteration, while the previous\n"
+              << "                   keys are being sent (default: disabled)\n"
+              << "    -u             Skip the local sort after the exchange (default: disabled)\n"
+              << "    -v             Build the histograms of the local sort with SIMD, needs AVX2\n"
+              << "                   at compile time (default: disabled)\n"
+              << "    -e, --encode <encoding>\n"
+              << "                   Send the keys as they are (none), bit-packed relative to their\n"
+              << "                   bucket (bits), or sorted and delta-encoded (delta), only with\n"
+              << "                   the round robin, incast, random and pairwise schedules and\n"
+              << "                   without -a (default: " << encode_name(pr.encode) << ")\n"
+              << "    -V, --verify <when>\n"
+              << "                   Check the buckets after none, the last or every iteration\n"
+              << "                   (default: " << verify_name(pr.verify) << ")\n"
+              << "    -T, --trace <prefix>\n"
+              << "                   Trace the fetch-adds, puts and quiets of every thread and\n"
+              << "                   dump them to <prefix>.<pe>.bin, see trace2chrome.cpp\n"
+              << "    -f, --format <format>\n"
+              << "                   Output format, table, json or csv (default: table)\n";
 }
 
 
@@ -88,8 +355,17 @@ void print_help(const params_t& pr)
 // Returns true if something goes wrong
 bool parse_args(const int argc, char** argv, params_t& pr)
 {
+    const struct option long_opts[] = {
+        {"help",   no_argument,       nullptr, 'h'},
+        {"verify", required_argument, nullptr, 'V'},
+        {"encode", required_argument, nullptr, 'e'},
+        {"trace",  required_argument, nullptr, 'T'},
+        {"format", required_argument, nullptr, 'f'},
+        {nullptr,  0,                 nullptr, 0}
+    };
+
     int c;
-    while ((c = getopt(argc, argv, "hcnpi:t:s:w:m:r:")) != -1) {
+    while ((c = getopt_long(argc, argv, "hcnpabguvi:t:s:w:m:r:l:d:e:V:T:f:", long_opts, nullptr)) != -1) {
         switch (c) {
             case 'h':
                 print_help(pr);
@@ -104,6 +380,21 @@ bool parse_args(const int argc, char** argv, params_t& pr)
                 pr.use_ctx = true;
                 pr.use_pipelining = true;
                 break;
+            case 'a':
+                pr.use_a2a_offsets = true;
+                break;
+            case 'b':
+                pr.use_splitters = true;
+                break;
+            case 'g':
+                pr.use_regen = true;
+                break;
+            case 'u':
+                pr.use_sort = false;
+                break;
+            case 'v':
+                pr.use_simd = true;
+                break;
             case 'i':
                 pr.iters = std::atol(optarg);
                 break;
@@ -122,15 +413,67 @@ bool parse_args(const int argc, char** argv, params_t& pr)
             case 'r':
                 {
                     const int type = std::atoi(optarg);
+                    pr.auto_comm = (type == 6);
                     if (type == 0) {
                         pr.comm = Sched::RoundRobin;
                     } else if (type == 1) {
                         pr.comm = Sched::Incast;
+                    } else if (type == 3) {
+                        pr.comm = Sched::Hierarchical;
+                    } else if (type == 4) {
+                        pr.comm = Sched::Bruck;
+                    } else if (type == 5) {
+                        pr.comm = Sched::Pairwise;
+                    } else if (type == 6) {
+                        // Picked in init_params
+                        pr.comm = Sched::Pairwise;
                     } else {
                         pr.comm = Sched::Random;
                     }
                     break;
                 }
+            case 'l':
+                pr.pes_per_node = std::atol(optarg);
+                break;
+            case 'd':
+                if (!parse_dist(optarg, pr.dist)) {
+                    std::cout << "Error: unknown distribution \"" << optarg << "\"\n";
+                    return true;
+                }
+                break;
+            case 'e':
+                if (std::string(optarg) == "none") {
+                    pr.encode = Encode::None;
+                } else if (std::string(optarg) == "bits") {
+                    pr.encode = Encode::Bits;
+                } else if (std::string(optarg) == "delta") {
+                    pr.encode = Encode::Delta;
+                } else {
+                    std::cout << "Error: unknown encoding \"" << optarg << "\"\n";
+                    return true;
+                }
+                break;
+            case 'V':
+                if (std::string(optarg) == "none") {
+                    pr.verify = Verify::None;
+                } else if (std::string(optarg) == "last") {
+                    pr.verify = Verify::Last;
+                } else if (std::string(optarg) == "every") {
+                    pr.verify = Verify::Every;
+                } else {
+                    std::cout << "Error: unknown verification \"" << optarg << "\"\n";
+                    return true;
+                }
+                break;
+            case 'T':
+                pr.trace_prefix = optarg;
+                break;
+            case 'f':
+                if (!reporter::parse_format(optarg, pr.fmt)) {
+                    std::cout << "Error: unknown output format \"" << optarg << "\"\n";
+                    return true;
+                }
+                break;
             default:
                 break;
         }
@@ -140,6 +483,43 @@ bool parse_args(const int argc, char** argv, params_t& pr)
 }
 
 
+// Find the nodes of the hierarchical schedule, the PEs of a node must be
+// consecutive and reachable with shmem_ptr from each other, and all the nodes
+// must have the same number of PEs
+// Returns true if something goes wrong
+bool init_nodes(params_t& pr, const size_t npes)
+{
+    const size_t mype = shmem_my_pe();
+
+    if (pr.pes_per_node == 0) {
+        for (size_t p = 0; p < npes; p++) {
+            if (shmem_ptr(pSync_node, p) != nullptr) {
+                pr.pes_per_node++;
+            }
+        }
+    }
+
+    if ((pr.pes_per_node == 0) || (npes % pr.pes_per_node != 0)) {
+        std::cout << "Error: PE " << mype << " can't split " << npes << " PEs into nodes of "
+                  << pr.pes_per_node << " PEs\n";
+        return true;
+    }
+
+    const size_t first = mype / pr.pes_per_node * pr.pes_per_node;
+
+    for (size_t p = first; p < first + pr.pes_per_node; p++) {
+        if (shmem_ptr(pSync_node, p) == nullptr) {
+            std::cout << "Error: PE " << mype << " can't reach PE " << p << " of its node with shmem_ptr\n";
+            return true;
+        }
+    }
+
+    pr.n_nodes = npes / pr.pes_per_node;
+
+    return false;
+}
+
+
 void init_params(params_t& pr, const size_t npes)
 {
     pr.n_buckets = npes * pr.n_threads;
@@ -151,9 +531,20 @@ void init_params(params_t& pr, const size_t npes)
     // And make sure npes divides n_keys
     pr.n_keys = npes * pr.n_threads * pr.n_keys_th;
 
+    // A thread sends about n_keys_th / npes keys to every PE
+    if (pr.auto_comm) {
+        const size_t bytes = pr.n_keys_th * sizeof(key_type) / npes;
+        pr.comm = (bytes < BRUCK_MAX_BYTES) ? Sched::Bruck : Sched::Pairwise;
+    }
+
     // Uniform bucket width for all the buckets
     pr.bucket_width = std::ceil(double(MAX_KEY) / pr.n_buckets);
 
+    pr.bounds.resize(pr.n_buckets + 1);
+    for (size_t b = 0; b <= pr.n_buckets; b++) {
+        pr.bounds[b] = std::min(b * pr.bucket_width, size_t(MAX_KEY) + 1);
+    }
+
     // Allocate buckets on the symmetric heap (w/ scaling)
     const size_t bucket_len = size_t(pr.n_keys_th * pr.mem_scale);
     const size_t page_size  = sysconf(_SC_PAGESIZE);
@@ -166,273 +557,1617 @@ void init_params(params_t& pr, const size_t npes)
 
     // Other thread-specific variables
     pr.recv_offsets = (size_t*)shmem_malloc(pr.n_threads * sizeof(size_t));
-    pr.n_recv_keys  = (size_t*)shmem_malloc(pr.n_threads * sizeof(size_t));
 
-    T_pe = 0.0;
-}
+    pr.sent_rows.resize(pr.n_threads * pr.n_buckets);
 
+    const size_t wrk_len = std::max(pr.n_buckets / 2 + 1, size_t(SHMEM_REDUCE_MIN_WRKDATA_SIZE));
 
-void bucket_sort(params_t& pr, double& T_pe)
-{
-    const size_t mype = shmem_my_pe();
-    const size_t npes = shmem_n_pes();
-    const size_t tid  = omp_get_thread_num();
+    pr.sent_keys       = (long*)shmem_malloc(pr.n_buckets * sizeof(long));
+    pr.total_sent_keys = (long*)shmem_malloc(pr.n_buckets * sizeof(long));
+    pr.pWrk_verify     = (long*)shmem_malloc(wrk_len * sizeof(long));
 
-    shmem_ctx_t ctx_amo, ctx_put;
+    const size_t a2a_len = npes * pr.n_threads * pr.n_threads;
 
-    if (pr.use_ctx) {
-        shmem_ctx_create(SHMEM_CTX_PRIVATE, &ctx_amo);
-        shmem_ctx_quiet(ctx_amo);
+    pr.a2a_counts     = (size_t*)shmem_malloc(a2a_len * sizeof(size_t));
+    pr.a2a_counts_in  = (size_t*)shmem_malloc(a2a_len * sizeof(size_t));
+    pr.a2a_offsets    = (size_t*)shmem_malloc(a2a_len * sizeof(size_t));
+    pr.a2a_offsets_in = (size_t*)shmem_malloc(a2a_len * sizeof(size_t));
 
-        if (pr.use_pipelining) {
-            shmem_ctx_create(SHMEM_CTX_PRIVATE, &ctx_put);
-            shmem_ctx_quiet(ctx_put);
-        } else {
-            ctx_put = ctx_amo;
-        }
+    pr.node_counts = nullptr;
+    pr.stage_out   = nullptr;
+    pr.stage_in    = nullptr;
 
-    } else {
-        ctx_amo = SHMEM_CTX_DEFAULT;
-        ctx_put = SHMEM_CTX_DEFAULT;
-    }
+    // A message between two nodes holds the sizes of the buckets of the
+    // destination node, then about n_keys_th keys from each of the threads
+    // of the source node for each of these buckets (w/ scaling)
+    if (pr.comm == Sched::Hierarchical) {
+        const size_t node_len = pr.pes_per_node * pr.n_threads;
+        const size_t pair_len = size_t(std::ceil(double(node_len) * node_len * pr.n_keys_th / pr.n_buckets * pr.mem_scale));
+        const size_t n_slots  = (pr.n_nodes + pr.pes_per_node - 1) / pr.pes_per_node;
 
-    std::mt19937_64 rng(mype * pr.n_threads + tid);
-    std::uniform_int_distribution<key_type> dis(0, MAX_KEY);
+        pr.stage_slot_bytes = node_len * sizeof(size_t) + pair_len * sizeof(key_type);
+        pr.stage_slot_bytes = (pr.stage_slot_bytes + 63) / 64 * 64;
 
-    // Generate random keys and increase the local counter for the corresponding bucket
-    std::vector<key_type> keys(pr.n_keys_th);
-    std::vector<size_t> local_bucket_sizes(pr.n_buckets);
-    for (size_t i = 0; i < pr.n_keys_th; i++) {
-        keys[i] = dis(rng);
-        local_bucket_sizes[keys[i] / pr.bucket_width]++;
+        pr.node_counts = (size_t*)shmem_malloc(pr.n_threads * pr.n_buckets * sizeof(size_t));
+        pr.stage_out   = (char*)shmem_align(page_size, n_slots * pr.stage_slot_bytes);
+        pr.stage_in    = (char*)shmem_align(page_size, n_slots * pr.stage_slot_bytes);
+        assert((pr.stage_out != nullptr) && (pr.stage_in != nullptr));
     }
 
-    // Store the random all-to-all schedules if needed
-    std::vector<size_t> shuffled_pes(npes);
-    for (size_t p = 0; p < npes; p++) {
-        shuffled_pes[p] = p;
+    pr.samples     = nullptr;
+    pr.all_samples = nullptr;
+
+    if (pr.use_splitters) {
+        pr.samples     = (key_type*)shmem_malloc(pr.n_threads * SAMPLES_PER_THREAD * sizeof(key_type));
+        pr.all_samples = (key_type*)shmem_malloc(pr.n_buckets * SAMPLES_PER_THREAD * sizeof(key_type));
     }
 
+    pr.bucket_keys = (size_t*)shmem_malloc(pr.n_buckets * sizeof(size_t));
+    pr.wire_bytes  = (size_t*)shmem_malloc(pr.n_buckets * sizeof(size_t));
 
-    // To partition all local keys based on which bucket they belong to, and
-    // put them into a send buffer, we need to first compute the starting
-    // offset of each bucket in the buffer
-    // Another identical array is needed to record the next empty slot of each
-    // of the local bucket in the buffer when we fill it, this array will be
-    // destroyed in the process
-    std::vector<size_t> send_buffer_offsets(pr.n_buckets, 0);
-    for (size_t i = 1; i < pr.n_buckets; i++) {
-        send_buffer_offsets[i] = send_buffer_offsets[i - 1] + local_bucket_sizes[i - 1];
+    pr.wire_offsets = nullptr;
+    pr.wire_len     = 0;
+
+    // A bucket gets at most one record from every thread, and a record holds
+    // at most as many words as keys, plus its header and padding
+    if (pr.encode != Encode::None) {
+        pr.wire_len = bucket_len + RECORD_EXTRA_WORDS * pr.n_buckets;
+
+        for (size_t i = 0; i < pr.n_threads; i++) {
+            auto wire = (uint32_t*)shmem_align(page_size, pr.wire_len * sizeof(uint32_t));
+            assert(wire != nullptr);
+            pr.wire.push_back(wire);
+        }
+
+        pr.wire_offsets = (size_t*)shmem_malloc(pr.n_threads * sizeof(size_t));
     }
-    std::vector<size_t> next_slots = send_buffer_offsets;
 
-    // Create and fill the bucketed send buffer
-    auto send_buffer = std::make_unique<key_type[]>(pr.n_keys_th);
-    for (size_t i = 0; i < pr.n_keys_th; i++) {
-        send_buffer[next_slots[keys[i] / pr.bucket_width]++] = keys[i];
+    pr.bruck_rounds = 0;
+    pr.bruck_in     = nullptr;
+    pr.bruck_flags  = nullptr;
+
+    // A round sends at most (npes + 1) / 2 blocks of about n_keys_th / npes
+    // keys (w/ scaling), after the sizes of the buckets of every block
+    if (pr.comm == Sched::Bruck) {
+        while ((1UL << pr.bruck_rounds) < npes) {
+            pr.bruck_rounds++;
+        }
+
+        const size_t n_blocks = (npes + 1) / 2;
+        const size_t slot_len = size_t(std::ceil(double(n_blocks) * pr.n_keys_th / npes * pr.mem_scale));
+
+        pr.bruck_slot_bytes = n_blocks * pr.n_threads * sizeof(size_t) + slot_len * sizeof(key_type);
+        pr.bruck_slot_bytes = (pr.bruck_slot_bytes + 63) / 64 * 64;
+
+        const size_t n_slots = pr.n_threads * std::max(pr.bruck_rounds, size_t(1));
+
+        pr.bruck_in    = (char*)shmem_align(page_size, n_slots * pr.bruck_slot_bytes);
+        pr.bruck_flags = (uint64_t*)shmem_calloc(n_slots, sizeof(uint64_t));
+        assert((pr.bruck_in != nullptr) && (pr.bruck_flags != nullptr));
     }
 
-    const size_t warmup_iters = std::max(size_t(20), pr.iters / 10);
+    T_sample_pe = 0.0;
 
-    timespec t0, t1;
+    T_stride = (pr.iters + 7) / 8 * 8;
+    T_iters  = (double*)shmem_align(64, pr.n_buckets * N_TIMES * T_stride * sizeof(double));
+    assert(T_iters != nullptr);
+}
 
-    // Begin all-to-all key exchange
-    for (size_t i = 0; i < pr.iters + warmup_iters; i++) {
-        // Clear the counters
-        pr.recv_offsets[tid] = 0;
-        pr.n_recv_keys[tid]  = 0;
 
-        // Generate a new random all-to-all schedule if random scheduling is enabled
-        if (pr.comm == Sched::Random) {
-            std::shuffle(shuffled_pes.begin(), shuffled_pes.end(), rng);
-        }
+// Turn 64 random bits into a key of the distribution d
+inline key_type draw_key(const Dist d, const uint64_t z)
+{
+    const double range = double(MAX_KEY) + 1.0;
 
-        #pragma omp barrier
-        #pragma omp master
-        {
-            total_exchanged_keys = 0;
+    // Scale the upper 32 bits to [0, MAX_KEY]
+    const key_type uniform = key_type(((z >> 32) * (uint64_t(MAX_KEY) + 1)) >> 32);
 
-            if (i == warmup_iters) {
-                T_pe = 0.0;
+    switch (d) {
+        case Dist::Zipf:
+            {
+                // Inverse of the CDF of the continuous power law over the
+                // ranks [1, range + 1)
+                const double u = (z >> 11) / 9007199254740992.0;
+                const double e = 1.0 - ZIPF_S;
+                const double k = std::pow((std::pow(range + 1.0, e) - 1.0) * u + 1.0, 1.0 / e);
+
+                return key_type(std::min(k - 1.0, double(MAX_KEY)));
+            }
+        case Dist::Gaussian:
+            {
+                // Box-Muller with the two halves of z
+                const double u1 = ((z >> 32) + 1.0) / 4294967296.0;
+                const double u2 = (z & 0xffffffffUL) / 4294967296.0;
+                const double n  = std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+                const double k  = range / 2.0 + n * range / GAUSS_SIGMA_DIV;
+
+                return key_type(std::min(std::max(k, 0.0), double(MAX_KEY)));
             }
+        case Dist::HotKey:
+            if ((z & 0xffff) < uint64_t(HOT_FRACTION * 0x10000)) {
+                const uint64_t h = ((z >> 16) & 0xffff) % HOT_KEYS;
+                return key_type((2 * h + 1) * (uint64_t(MAX_KEY) / (2 * HOT_KEYS)));
+            }
+            return uniform;
+        default:
+            return uniform;
+    }
+}
 
-            shmem_barrier_all();
-        }
-        #pragma omp barrier
 
-        // Start the timer
-        clock_gettime(CLOCK_MONOTONIC, &t0);
+// Counter-based RNG: a key is a hash of the iteration and of its index among
+// all the keys, so any slice of the keys can be generated on its own and the
+// loop vectorizes for uniform keys
+inline key_type key_at(const Dist d, const uint64_t seed, const uint64_t ctr)
+{
+    // SplitMix64 finalizer
+    uint64_t z = seed * 0xd1b54a32d192ed03UL + ctr * 0x9e3779b97f4a7c15UL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+    z = z ^ (z >> 31);
 
-        // Send keys
-        for (size_t _p = 0; _p < npes; _p++) {
-            size_t p;
+    return draw_key(d, z);
+}
 
-            switch (pr.comm) {
-                case Sched::Incast:
-                    p = _p;
-                    break;
-                case Sched::RoundRobin:
-                    p = (mype + _p) % npes;
-                    break;
-                default:
-                    p = shuffled_pes[_p];
-                    break;
-            }
 
-            for (size_t t = 0; t < pr.n_threads; t++) {
-                const size_t bucket_id   = p * pr.n_threads + t;
-                const size_t send_offset = send_buffer_offsets[bucket_id];
-                const size_t send_size   = local_bucket_sizes[bucket_id];
-                const size_t recv_offset = shmem_ctx_size_atomic_fetch_add(ctx_amo, &pr.recv_offsets[t], send_size, p);
+// The bucket of a key, a division unless the bounds come from splitters
+inline size_t bucket_of(const params_t& pr, const key_type key)
+{
+    if (!pr.use_splitters) {
+        return key / pr.bucket_width;
+    }
 
-                if (pr.use_nbi) {
-                    shmem_ctx_putmem_nbi(ctx_put, &pr.buckets[t][recv_offset], &send_buffer[send_offset], send_size * sizeof(key_type), p);
-                } else {
-                    shmem_ctx_putmem(ctx_put, &pr.buckets[t][recv_offset], &send_buffer[send_offset], send_size * sizeof(key_type), p);
-                }
-            }
-        }
+    return std::upper_bound(pr.bounds.begin() + 1, pr.bounds.end(), key) - pr.bounds.begin() - 1;
+}
 
-        // Ensure remote completion
-        shmem_ctx_quiet(ctx_put);
 
-        clock_gettime(CLOCK_MONOTONIC, &t1);
+// Fill keys[first, last) of a thread for the iteration seed, and count them in
+// the buckets they belong to
+void generate_keys(const params_t& pr, const uint64_t seed, const size_t gtid,
+                   const size_t first, const size_t last,
+                   key_type* keys, size_t* bucket_sizes)
+{
+    const uint64_t base = gtid * pr.n_keys_th;
 
-        #pragma omp atomic
-        T_pe += (t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1000000.0;
+    for (size_t i = first; i < last; i++) {
+        keys[i] = key_at(pr.dist, seed, base + i);
+    }
 
-        #pragma omp barrier
-        #pragma omp master
-        shmem_sync_all();
-        #pragma omp barrier
+    for (size_t i = first; i < last; i++) {
+        bucket_sizes[bucket_of(pr, keys[i])]++;
+    }
+}
 
-        // Local sorting should happen here, but we skip this step
 
-        // Make sure that there were no overflow
-        assert(pr.recv_offsets[tid] <= size_t(pr.n_keys_th * pr.mem_scale));
+// Pick the bounds of the buckets so that they get about the same number of
+// keys: every thread takes SAMPLES_PER_THREAD of its keys, evenly spaced, all
+// the samples are gathered on every PE and sorted, and the bounds are every
+// SAMPLES_PER_THREAD-th sample. Equal samples, from keys that are much more
+// common than a bucket, are pushed apart so that no bucket range is empty.
+// Must be called by all the threads.
+void select_splitters(params_t& pr, const key_type* keys, const size_t tid, const size_t npes)
+{
+    for (size_t k = 0; k < SAMPLES_PER_THREAD; k++) {
+        pr.samples[tid * SAMPLES_PER_THREAD + k] = keys[k * pr.n_keys_th / SAMPLES_PER_THREAD];
+    }
 
-        // Make sure that every thread received something (may fail for small numbers of keys)
-        assert(pr.recv_offsets[tid] > 0);
+    #pragma omp barrier
+    #pragma omp master
+    {
+        shmem_fcollect32(pr.all_samples, pr.samples, pr.n_threads * SAMPLES_PER_THREAD, 0, 0, npes, pSync_collect);
 
-        // Verify that all keys in our bucket are within range
-        const key_type my_min_key = ((mype * pr.n_threads) + tid) * pr.bucket_width;
-        const key_type my_max_key = my_min_key + pr.bucket_width;
-        for (size_t k = 0; k < pr.recv_offsets[tid]; k++) {
-            const key_type key = pr.buckets[tid][k];
-            assert((key >= my_min_key) && (key < my_max_key));
-        }
+        std::sort(pr.all_samples, pr.all_samples + pr.n_buckets * SAMPLES_PER_THREAD);
 
-        // Verify sum of portions of each bucket equals to recv_offset
-        for (size_t p = 0; p < npes; p++) {
-            for (size_t t = 0; t < pr.n_threads; t++) {
-                shmem_size_atomic_add(&pr.n_recv_keys[t], local_bucket_sizes[p * pr.n_threads + t], p);
-            }
+        pr.bounds[0] = 0;
+        for (size_t b = 1; b < pr.n_buckets; b++) {
+            pr.bounds[b] = std::max(pr.all_samples[b * SAMPLES_PER_THREAD], key_type(pr.bounds[b - 1] + 1));
         }
+        pr.bounds[pr.n_buckets] = MAX_KEY + 1;
 
-        #pragma omp barrier
-        #pragma omp master
-        {
-            // Verify that all keys are processed (sum of bucket sizes == n_keys)
-            size_t n_received_keys = 0;
-            for (size_t t = 0; t < pr.n_threads; t++) {
-                n_received_keys += pr.recv_offsets[t];
-            }
-            shmem_size_atomic_add(&total_exchanged_keys, n_received_keys, 0);
+        assert(pr.bounds[pr.n_buckets - 1] <= MAX_KEY);
+    }
+    #pragma omp barrier
+}
 
-            // Complete the atomics
-            shmem_barrier_all();
 
-            if (mype == 0) {
-                assert(total_exchanged_keys == pr.n_keys);
-            }
-        }
-        #pragma omp barrier
+// To partition all local keys based on which bucket they belong to, and put
+// them into a send buffer, we need to first compute the starting offset of
+// each bucket in the buffer
+// Another identical array is needed to record the next empty slot of each of
+// the local bucket in the buffer when we fill it, this array will be destroyed
+// in the process
+void pack_keys(const params_t& pr, const key_type* keys, const size_t* bucket_sizes,
+               size_t* send_buffer_offsets, key_type* send_buffer)
+{
+    send_buffer_offsets[0] = 0;
+    for (size_t i = 1; i < pr.n_buckets; i++) {
+        send_buffer_offsets[i] = send_buffer_offsets[i - 1] + bucket_sizes[i - 1];
+    }
+    std::vector<size_t> next_slots(send_buffer_offsets, send_buffer_offsets + pr.n_buckets);
 
-        assert(pr.n_recv_keys[tid] == pr.recv_offsets[tid]);
+    for (size_t i = 0; i < pr.n_keys_th; i++) {
+        send_buffer[next_slots[bucket_of(pr, keys[i])]++] = keys[i];
     }
+}
 
-    if (pr.use_ctx) {
-        shmem_ctx_destroy(ctx_amo);
 
-        if (pr.use_pipelining) {
-            shmem_ctx_destroy(ctx_put);
+// Reserve the slots of the keys of all the threads in the receiving buckets
+// with two all-to-alls instead of npes * n_threads fetch-adds per thread: the
+// counts go to the receivers, which scan them in sender PE & thread order and
+// send the offsets back. The offset of the keys of thread s for bucket t of
+// PE p ends up in a2a_offsets_in[p * n_threads^2 + t * n_threads + s], and
+// recv_offsets ends up as the number of keys of every bucket like with the
+// fetch-adds. Must be called by all the threads of a PE.
+void reserve_offsets(params_t& pr, const size_t* bucket_sizes, const size_t tid, const size_t npes)
+{
+    const size_t nt  = pr.n_threads;
+    const size_t blk = nt * nt;
+
+    for (size_t p = 0; p < npes; p++) {
+        for (size_t t = 0; t < nt; t++) {
+            pr.a2a_counts[p * blk + t * nt + tid] = bucket_sizes[p * nt + t];
+        }
+    }
+
+    #pragma omp barrier
+    #pragma omp master
+    {
+        shmem_alltoall64(pr.a2a_counts_in, pr.a2a_counts, blk, 0, 0, npes, pSync_a2a[0]);
+
+        for (size_t t = 0; t < nt; t++) {
+            size_t sum = 0;
+
+            for (size_t q = 0; q < npes; q++) {
+                for (size_t s = 0; s < nt; s++) {
+                    const size_t idx = q * blk + t * nt + s;
+
+                    pr.a2a_offsets[idx] = sum;
+                    sum += pr.a2a_counts_in[idx];
+                }
+            }
+
+            pr.recv_offsets[t] = sum;
         }
+
+        shmem_alltoall64(pr.a2a_offsets_in, pr.a2a_offsets, blk, 0, 0, npes, pSync_a2a[1]);
     }
+    #pragma omp barrier
 }
 
 
-void cleanup_params(params_t& pr)
+// Barrier among the PEs of this node, must be called by all the threads
+void node_barrier(const params_t& pr)
 {
-    for (auto p : pr.buckets) {
-        shmem_free(p);
-    }
+    const size_t first = shmem_my_pe() / pr.pes_per_node * pr.pes_per_node;
 
-    shmem_free(pr.recv_offsets);
-    shmem_free(pr.n_recv_keys);
+    #pragma omp barrier
+    #pragma omp master
+    shmem_barrier(first, 0, pr.pes_per_node, pSync_node);
+    #pragma omp barrier
 }
 
 
-int main(int argc, char** argv)
+// The three stages of the hierarchical schedule, for pes_per_node = L:
+//   hier_gather:  every thread copies its keys by pointer into the staging
+//                 buffers of the PEs of its node, node s gathers the keys for
+//                 node d on its PE of rank d % L, in slot d / L of stage_out
+//   hier_send:    these PEs send each slot in one message, to the PE of rank
+//                 s % L of node d, in slot s / L of stage_in
+//   hier_scatter: the receiving PEs reserve space in the final buckets of
+//                 their node and copy the keys there by pointer
+// So there are n_nodes^2 messages between nodes instead of npes^2 * n_threads
+// A message holds the sizes of the L * n_threads buckets of node d, then their
+// keys, bucket by bucket, in the order of the threads of node s that sent them
+// Must be called by all the threads
+void hier_gather(params_t& pr, const size_t* bucket_sizes, const size_t* send_buffer_offsets,
+                 const key_type* send_buffer, const size_t tid)
 {
-    params_t pr;
+    const size_t mype     = shmem_my_pe();
+    const size_t node_len = pr.pes_per_node * pr.n_threads;
+    const size_t rank     = mype % pr.pes_per_node;
+    const size_t first    = mype - rank;
+    // Index of this thread among the threads of the node
+    const size_t g        = rank * pr.n_threads + tid;
 
-    pr.iters          = 50;
-    pr.n_threads      = 1;
-    pr.use_ctx        = false;
-    pr.use_nbi        = false;
-    pr.use_pipelining = false;
-    pr.comm           = Sched::RoundRobin;
-    pr.n_keys         = 1UL << 29;
-    pr.n_keys_th      = 0;
-    pr.mem_scale      = 1.2;
+    const size_t pair_len = (pr.stage_slot_bytes - node_len * sizeof(size_t)) / sizeof(key_type);
 
-    // Exit in case anything goes wrong
-    if (parse_args(argc, argv, pr)) {
-        return 1;
-    }
+    std::copy(bucket_sizes, bucket_sizes + pr.n_buckets, &pr.node_counts[tid * pr.n_buckets]);
 
-    for (int i = 0; i < SHMEM_REDUCE_SYNC_SIZE; i++) {
-        pSync[i] = SHMEM_SYNC_VALUE;
+    std::vector<const size_t*> counts(pr.pes_per_node);
+    for (size_t r = 0; r < pr.pes_per_node; r++) {
+        counts[r] = (const size_t*)shmem_ptr(pr.node_counts, first + r);
     }
 
-    int tl, tl_supported;
+    // Wait for the sizes of all the threads of the node
+    node_barrier(pr);
 
-    if (pr.n_threads == 1) {
-        tl = SHMEM_THREAD_FUNNELED;
-    } else {
-        tl = SHMEM_THREAD_MULTIPLE;
-    }
+    for (size_t d = 0; d < pr.n_nodes; d++) {
+        char* slot     = (char*)shmem_ptr(pr.stage_out, first + d % pr.pes_per_node) + d / pr.pes_per_node * pr.stage_slot_bytes;
+        size_t* header = (size_t*)slot;
+        key_type* out  = (key_type*)(slot + node_len * sizeof(size_t));
 
-    shmem_init_thread(tl, &tl_supported);
+        size_t start = 0;
 
-    if (tl != tl_supported) {
-        if (shmem_my_pe() == 0) {
-            std::cout << "Error: Could not enable the desired thread level!\n";
+        for (size_t b = 0; b < node_len; b++) {
+            const size_t bucket_id = d * node_len + b;
+
+            // Keys of the threads of the node before this one, and of all
+            size_t before = 0, total = 0;
+
+            for (size_t h = 0; h < node_len; h++) {
+                const size_t c = counts[h / pr.n_threads][(h % pr.n_threads) * pr.n_buckets + bucket_id];
+
+                before += (h < g) ? c : 0;
+                total  += c;
+            }
+
+            assert(start + total <= pair_len);
+
+            std::copy(&send_buffer[send_buffer_offsets[bucket_id]],
+                      &send_buffer[send_buffer_offsets[bucket_id] + bucket_sizes[bucket_id]],
+                      &out[start + before]);
+
+            if (g == 0) {
+                header[b] = total;
+            }
+
+            start += total;
         }
-        shmem_global_exit(1);
     }
 
-    const size_t mype = shmem_my_pe();
-    const size_t npes = shmem_n_pes();
+    // Wait for all the keys of the node
+    node_barrier(pr);
+}
 
-    init_params(pr, npes);
+
+// Send the slots gathered on this PE, the threads take turns, in round robin
+// order of the nodes starting from this one
+void hier_send(const params_t& pr, shmem_ctx_t ctx, const size_t tid, trace_ring* trace, const size_t iter)
+{
+    const size_t mype     = shmem_my_pe();
+    const size_t node_len = pr.pes_per_node * pr.n_threads;
+    const size_t rank     = mype % pr.pes_per_node;
+    const size_t node     = mype / pr.pes_per_node;
+
+    size_t k = 0;
+
+    for (size_t _d = 0; _d < pr.n_nodes; _d++) {
+        const size_t d = (node + _d) % pr.n_nodes;
+
+        if (d % pr.pes_per_node != rank) {
+            continue;
+        }
+
+        if (k++ % pr.n_threads != tid) {
+            continue;
+        }
+
+        const char* slot     = pr.stage_out + d / pr.pes_per_node * pr.stage_slot_bytes;
+        const size_t* header = (const size_t*)slot;
+
+        size_t n = 0;
+        for (size_t b = 0; b < node_len; b++) {
+            n += header[b];
+        }
+
+        char* dest         = pr.stage_in + node / pr.pes_per_node * pr.stage_slot_bytes;
+        const size_t bytes = node_len * sizeof(size_t) + n * sizeof(key_type);
+        const size_t pe    = d * pr.pes_per_node + node % pr.pes_per_node;
+
+        const timer::ticks t0 = trace ? timer::now() : 0;
+
+        if (pr.use_nbi) {
+            shmem_ctx_putmem_nbi(ctx, dest, slot, bytes, pe);
+        } else {
+            shmem_ctx_putmem(ctx, dest, slot, bytes, pe);
+        }
+
+        if (trace) {
+            trace->record(trace_kind::Put, t0, timer::now(), pe, iter, bytes);
+        }
+    }
+}
+
+
+// Copy the keys of the messages received by this PE into the buckets of the
+// node, the threads take turns bucket by bucket, the messages of all the nodes
+// must have arrived
+void hier_scatter(params_t& pr, const size_t tid)
+{
+    const size_t mype     = shmem_my_pe();
+    const size_t node_len = pr.pes_per_node * pr.n_threads;
+    const size_t rank     = mype % pr.pes_per_node;
+    const size_t first    = mype - rank;
+
+    size_t k = 0;
+
+    for (size_t s = rank; s < pr.n_nodes; s += pr.pes_per_node) {
+        const char* slot     = pr.stage_in + s / pr.pes_per_node * pr.stage_slot_bytes;
+        const size_t* header = (const size_t*)slot;
+        const key_type* in   = (const key_type*)(slot + node_len * sizeof(size_t));
+
+        size_t start = 0;
+
+        for (size_t b = 0; b < node_len; b++) {
+            const size_t n = header[b];
+
+            if ((k++ % pr.n_threads == tid) && (n > 0)) {
+                const size_t pe = first + b / pr.n_threads;
+                const size_t t  = b % pr.n_threads;
+
+                size_t* offset = (size_t*)shmem_ptr(&pr.recv_offsets[t], pe);
+                const size_t recv_offset = __atomic_fetch_add(offset, n, __ATOMIC_RELAXED);
+
+                assert(recv_offset + n <= size_t(pr.n_keys_th * pr.mem_scale));
+
+                std::copy(&in[start], &in[start + n], (key_type*)shmem_ptr(&pr.buckets[t][recv_offset], pe));
+            }
+
+            start += n;
+        }
+    }
+}
+
+
+// Bruck's all-to-all among thread tid of all the PEs, in bruck_rounds rounds
+// instead of npes messages
+// Block j of a thread holds the keys that go to PE mype + j (mod npes), in
+// round r the blocks whose j has bit r set are sent together to PE mype + 2^r,
+// which keeps them as its own blocks j, so after the last round block j holds
+// the keys that PE mype - j sent to this PE. The blocks that move on stay in
+// the receive slots of the earlier rounds in the meantime. A message holds the
+// sizes of the n_threads buckets of each block, then the keys of the blocks
+// The keys end up in the buckets of this PE, as with the other schedules.
+// next_round(r) is called once the message of round r is sent, before waiting
+// for the one to receive, epoch must grow in every iteration, the trace gets
+// the puts and the waits of iteration epoch - 1
+template <typename F>
+void bruck_exchange(params_t& pr, const size_t* bucket_sizes, const size_t* send_buffer_offsets,
+                    const key_type* send_buffer, shmem_ctx_t ctx, const size_t tid,
+                    const uint64_t epoch, trace_ring* trace, F&& next_round)
+{
+    const size_t mype = shmem_my_pe();
+    const size_t npes = shmem_n_pes();
+    const size_t nt   = pr.n_threads;
+
+    const size_t hdr_bytes = (npes + 1) / 2 * nt * sizeof(size_t);
+    const size_t slot_len  = (pr.bruck_slot_bytes - hdr_bytes) / sizeof(key_type);
+
+    // Where the keys of every block are, and the sizes of its buckets
+    std::vector<const key_type*> data(npes);
+    std::vector<const size_t*> sizes(npes);
+
+    for (size_t j = 0; j < npes; j++) {
+        const size_t p = (mype + j) % npes;
+
+        data[j]  = &send_buffer[send_buffer_offsets[p * nt]];
+        sizes[j] = &bucket_sizes[p * nt];
+    }
+
+    static thread_local std::vector<char> msg;
+    msg.resize(pr.bruck_slot_bytes);
+
+    for (size_t r = 0; r < pr.bruck_rounds; r++) {
+        const size_t bit = 1UL << r;
+        const size_t pe  = (mype + bit) % npes;
+
+        char* slot     = &pr.bruck_in[(tid * pr.bruck_rounds + r) * pr.bruck_slot_bytes];
+        uint64_t* flag = &pr.bruck_flags[tid * pr.bruck_rounds + r];
+
+        size_t* header = (size_t*)msg.data();
+        key_type* out  = (key_type*)(msg.data() + hdr_bytes);
+
+        size_t m = 0, n = 0;
+
+        for (size_t j = bit; j < npes; j++) {
+            if (!(j & bit)) {
+                continue;
+            }
+
+            size_t len = 0;
+            for (size_t t = 0; t < nt; t++) {
+                header[m * nt + t] = sizes[j][t];
+                len += sizes[j][t];
+            }
+
+            assert(n + len <= slot_len);
+
+            std::copy(data[j], data[j] + len, &out[n]);
+
+            n += len;
+            m++;
+        }
+
+        const timer::ticks t0 = trace ? timer::now() : 0;
+
+        // The flag goes out after the keys
+        shmem_ctx_putmem(ctx, slot, msg.data(), hdr_bytes + n * sizeof(key_type), pe);
+        shmem_ctx_fence(ctx);
+        shmem_ctx_uint64_atomic_set(ctx, flag, epoch, pe);
+
+        if (trace) {
+            trace->record(trace_kind::Put, t0, timer::now(), pe, epoch - 1, hdr_bytes + n * sizeof(key_type));
+        }
+
+        next_round(r);
+
+        const timer::ticks t1 = trace ? timer::now() : 0;
+
+        shmem_uint64_wait_until(flag, SHMEM_CMP_GE, epoch);
+
+        if (trace) {
+            trace->record(trace_kind::Wait, t1, timer::now(), (mype + npes - bit) % npes, epoch - 1, 0);
+        }
+
+        // The received blocks replace the ones that were sent
+        const size_t* in_header = (const size_t*)slot;
+        const key_type* in      = (const key_type*)(slot + hdr_bytes);
+
+        m = 0;
+        n = 0;
+
+        for (size_t j = bit; j < npes; j++) {
+            if (!(j & bit)) {
+                continue;
+            }
+
+            sizes[j] = &in_header[m * nt];
+            data[j]  = &in[n];
+
+            for (size_t t = 0; t < nt; t++) {
+                n += sizes[j][t];
+            }
+
+            m++;
+        }
+    }
+
+    for (size_t t = 0; t < nt; t++) {
+        size_t total = 0;
+        for (size_t j = 0; j < npes; j++) {
+            total += sizes[j][t];
+        }
+
+        size_t recv_offset = __atomic_fetch_add(&pr.recv_offsets[t], total, __ATOMIC_RELAXED);
+
+        assert(recv_offset + total <= size_t(pr.n_keys_th * pr.mem_scale));
+
+        for (size_t j = 0; j < npes; j++) {
+            size_t first = 0;
+            for (size_t u = 0; u < t; u++) {
+                first += sizes[j][u];
+            }
+
+            std::copy(&data[j][first], &data[j][first + sizes[j][t]], &pr.buckets[t][recv_offset]);
+            recv_offset += sizes[j][t];
+        }
+    }
+}
+
+
+// Bits that the values in [0, range) need
+inline unsigned bits_for(const uint64_t range)
+{
+    unsigned bits = 0;
+    while ((1UL << bits) < range) {
+        bits++;
+    }
+
+    return bits;
+}
+
+
+// Words of a record of n keys of bits bits each
+inline size_t record_words(const size_t n, const unsigned bits)
+{
+    return RECORD_EXTRA_WORDS + (n * bits + 31) / 32;
+}
+
+
+// Encode the n keys that a thread sends to bucket b into a record: the number
+// of keys and the bits per key, the keys packed little-endian into 32-bit
+// words, and a word of padding that the decoder reads past the last key
+// The keys are sorted in place for the delta encoding.
+// Returns the length of the record in words
+size_t encode_record(const params_t& pr, const size_t b, key_type* keys, const size_t n, uint32_t* words)
+{
+    const bool delta    = (pr.encode == Encode::Delta);
+    const key_type base = pr.bounds[b];
+
+    unsigned bits;
+
+    if (delta) {
+        std::sort(keys, keys + n);
+
+        key_type max_gap = keys[0] - base;
+        for (size_t i = 1; i < n; i++) {
+            max_gap = std::max(max_gap, key_type(keys[i] - keys[i - 1]));
+        }
+
+        bits = bits_for(uint64_t(max_gap) + 1);
+    } else {
+        bits = bits_for(pr.bounds[b + 1] - base);
+    }
+
+    words[0] = uint32_t(n);
+    words[1] = bits;
+
+    uint32_t* out = words + 2;
+    size_t w = 0;
+
+    // Never more than 63 bits in the accumulator, since bits <= 32
+    uint64_t acc  = 0;
+    unsigned fill = 0;
+    key_type prev = base;
+
+    for (size_t i = 0; i < n; i++) {
+        acc |= uint64_t(keys[i] - prev) << fill;
+        fill += bits;
+
+        if (delta) {
+            prev = keys[i];
+        }
+
+        if (fill >= 32) {
+            out[w++] = uint32_t(acc);
+            acc >>= 32;
+            fill -= 32;
+        }
+    }
+
+    if (fill > 0) {
+        out[w++] = uint32_t(acc);
+    }
+
+    out[w++] = 0;
+
+    assert(2 + w == record_words(n, bits));
+
+    return 2 + w;
+}
+
+
+// Unpack n values of bits bits each from words, plus base, into out, eight at
+// a time with AVX2 gathers of the two words that hold every value
+// Reads the word after the last packed one.
+void unpack_bits(const uint32_t* words, const size_t n, const unsigned bits,
+                 const key_type base, key_type* out)
+{
+    if (bits == 0) {
+        std::fill(out, out + n, base);
+        return;
+    }
+
+    const uint64_t mask = (1UL << bits) - 1;
+
+    size_t i = 0;
+
+#ifdef __AVX2__
+    // The offsets of the values, in bits, are 32-bit lanes
+    if (n * bits < (1UL << 31)) {
+        const __m256i lane  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i vbits = _mm256_set1_epi32(bits);
+        const __m256i vmask = _mm256_set1_epi32(uint32_t(mask));
+        const __m256i vbase = _mm256_set1_epi32(base);
+        const __m256i low5  = _mm256_set1_epi32(31);
+        const __m256i v32   = _mm256_set1_epi32(32);
+        const __m256i one   = _mm256_set1_epi32(1);
+
+        for (; i + 8 <= n; i += 8) {
+            const __m256i pos = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(int(i)), lane), vbits);
+            const __m256i idx = _mm256_srli_epi32(pos, 5);
+            const __m256i sh  = _mm256_and_si256(pos, low5);
+            const __m256i lo  = _mm256_i32gather_epi32((const int*)words, idx, 4);
+            const __m256i hi  = _mm256_i32gather_epi32((const int*)words, _mm256_add_epi32(idx, one), 4);
+
+            // The shift of hi is 32, which gives 0, when the value starts at
+            // the beginning of a word
+            __m256i v = _mm256_or_si256(_mm256_srlv_epi32(lo, sh), _mm256_sllv_epi32(hi, _mm256_sub_epi32(v32, sh)));
+            v = _mm256_add_epi32(_mm256_and_si256(v, vmask), vbase);
+
+            _mm256_storeu_si256((__m256i*)(out + i), v);
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        const size_t pos = i * bits;
+        const uint64_t w = words[pos / 32] | (uint64_t(words[pos / 32 + 1]) << 32);
+
+        out[i] = base + key_type((w >> (pos % 32)) & mask);
+    }
+}
+
+
+// Decode the records in the wire buffer of thread tid into its bucket, right
+// where they are received, the gaps of the delta encoding are summed up after
+// unpacking
+void decode_bucket(params_t& pr, const size_t tid, const size_t gtid, const size_t bucket_len)
+{
+    const uint32_t* words = pr.wire[tid];
+    const key_type base   = pr.bounds[gtid];
+    key_type* bucket      = pr.buckets[tid];
+
+    size_t n_keys = 0;
+
+    for (size_t w = 0; w < pr.wire_offsets[tid]; ) {
+        const size_t n      = words[w];
+        const unsigned bits = words[w + 1];
+        key_type* out       = &bucket[n_keys];
+
+        // A bucket too small for the keys, raise -m
+        assert(n_keys + n <= bucket_len);
+
+        if (pr.encode == Encode::Delta) {
+            unpack_bits(&words[w + 2], n, bits, 0, out);
+
+            key_type prev = base;
+            for (size_t j = 0; j < n; j++) {
+                prev += out[j];
+                out[j] = prev;
+            }
+        } else {
+            unpack_bits(&words[w + 2], n, bits, base, out);
+        }
+
+        n_keys += n;
+        w += record_words(n, bits);
+    }
+
+    pr.recv_offsets[tid] = n_keys;
+}
+
+
+// Check that the n keys of a bucket are in [min_key, max_key), and sorted if
+// sorted is set, in one pass that vectorizes
+bool check_bucket(const key_type* keys, const size_t n, const key_type min_key,
+                  const key_type max_key, const bool sorted)
+{
+    if (n == 0) {
+        return true;
+    }
+
+    key_type lo = keys[n - 1];
+    key_type hi = keys[n - 1];
+    size_t unsorted = 0;
+
+    #pragma omp simd reduction(min:lo) reduction(max:hi) reduction(+:unsorted)
+    for (size_t i = 0; i < n - 1; i++) {
+        lo = (keys[i] < lo) ? keys[i] : lo;
+        hi = (keys[i] > hi) ? keys[i] : hi;
+        unsorted += (keys[i] > keys[i + 1]);
+    }
+
+    return (lo >= min_key) && (hi < max_key) && (!sorted || (unsorted == 0));
+}
+
+
+// Check that every bucket got all the keys that were sent to it, with the
+// counts of all the threads of all the PEs summed up in one reduction, and
+// that no key was lost. Must be called by all the threads.
+void check_counts(params_t& pr, const size_t* bucket_sizes, const size_t tid, const size_t npes)
+{
+    const size_t nt = pr.n_threads;
+
+    std::copy(bucket_sizes, bucket_sizes + pr.n_buckets, &pr.sent_rows[tid * pr.n_buckets]);
+
+    #pragma omp barrier
+
+    // Every thread sums the rows over a slice of the buckets
+    for (size_t b = tid; b < pr.n_buckets; b += nt) {
+        long sum = 0;
+        for (size_t t = 0; t < nt; t++) {
+            sum += pr.sent_rows[t * pr.n_buckets + b];
+        }
+        pr.sent_keys[b] = sum;
+    }
+
+    #pragma omp barrier
+    #pragma omp master
+    {
+        shmem_long_sum_to_all(pr.total_sent_keys, pr.sent_keys, pr.n_buckets, 0, 0, npes, pr.pWrk_verify, pSync_verify);
+
+        assert(std::accumulate(pr.total_sent_keys, pr.total_sent_keys + pr.n_buckets, 0L) == long(pr.n_keys));
+    }
+    #pragma omp barrier
+
+    assert(pr.total_sent_keys[shmem_my_pe() * nt + tid] == long(pr.recv_offsets[tid]));
+}
+
+
+// Sort the n keys of a bucket, which are in [min_key, min_key + width), by
+// counting how many times every value appears and writing them back in order
+void counting_sort(key_type* keys, const size_t n, const key_type min_key,
+                   const size_t width, std::vector<uint32_t>& counts)
+{
+    counts.assign(width, 0);
+
+    for (size_t i = 0; i < n; i++) {
+        counts[keys[i] - min_key]++;
+    }
+
+    size_t k = 0;
+    for (size_t v = 0; v < width; v++) {
+        for (uint32_t c = 0; c < counts[v]; c++) {
+            keys[k++] = min_key + v;
+        }
+    }
+}
+
+
+// Count the digits of all the passes in one sweep over the keys, the digits
+// are taken from the offsets of the keys to min_key
+void radix_histograms(const key_type* keys, const size_t n, const key_type min_key,
+                      const size_t n_passes, const bool use_simd,
+                      uint32_t hist[MAX_PASSES][RADIX])
+{
+    for (size_t p = 0; p < n_passes; p++) {
+        std::fill(hist[p], hist[p] + RADIX, 0);
+    }
+
+    size_t i = 0;
+
+#ifdef __AVX2__
+    if (use_simd) {
+        // Eight keys are turned into digits at once, and the digits go to four
+        // copies of the counters, so that runs of equal digits don't stall on
+        // incrementing the same counter
+        static thread_local uint32_t sub[4][MAX_PASSES][RADIX];
+
+        for (size_t p = 0; p < n_passes; p++) {
+            for (size_t c = 0; c < 4; c++) {
+                std::fill(sub[c][p], sub[c][p] + RADIX, 0);
+            }
+        }
+
+        const __m256i base = _mm256_set1_epi32(min_key);
+        const __m256i mask = _mm256_set1_epi32(RADIX - 1);
+
+        alignas(32) uint32_t digits[8];
+
+        for (; i + 8 <= n; i += 8) {
+            const __m256i v = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(keys + i)), base);
+
+            for (size_t p = 0; p < n_passes; p++) {
+                const __m256i d = _mm256_and_si256(_mm256_srli_epi32(v, int(p * RADIX_BITS)), mask);
+                _mm256_store_si256((__m256i*)digits, d);
+
+                for (size_t j = 0; j < 8; j++) {
+                    sub[j % 4][p][digits[j]]++;
+                }
+            }
+        }
+
+        for (size_t p = 0; p < n_passes; p++) {
+            for (size_t d = 0; d < RADIX; d++) {
+                hist[p][d] = sub[0][p][d] + sub[1][p][d] + sub[2][p][d] + sub[3][p][d];
+            }
+        }
+    }
+#else
+    (void)use_simd;
+#endif
+
+    for (; i < n; i++) {
+        const key_type v = keys[i] - min_key;
+
+        for (size_t p = 0; p < n_passes; p++) {
+            hist[p][(v >> (p * RADIX_BITS)) & (RADIX - 1)]++;
+        }
+    }
+}
+
+
+// LSD radix sort of the n keys of a bucket, which are in [min_key, min_key +
+// width), only the digits that width needs are sorted on, tmp must hold n keys
+void radix_sort(key_type* keys, key_type* tmp, const size_t n, const key_type min_key,
+                const size_t width, const bool use_simd)
+{
+    // An empty bucket, or one key, is already sorted
+    if (n < 2) {
+        return;
+    }
+
+    size_t bits = 0;
+    while ((1UL << bits) < width) {
+        bits++;
+    }
+
+    const size_t n_passes = (bits + RADIX_BITS - 1) / RADIX_BITS;
+
+    uint32_t hist[MAX_PASSES][RADIX];
+    radix_histograms(keys, n, min_key, n_passes, use_simd, hist);
+
+    key_type* src = keys;
+    key_type* dst = tmp;
+
+    for (size_t p = 0; p < n_passes; p++) {
+        const size_t shift = p * RADIX_BITS;
+
+        // Nothing moves if all the keys have the same digit
+        if (hist[p][((src[0] - min_key) >> shift) & (RADIX - 1)] == n) {
+            continue;
+        }
+
+        // Turn the counts into the first slots of the digits
+        uint32_t next[RADIX];
+        uint32_t sum = 0;
+        for (size_t d = 0; d < RADIX; d++) {
+            next[d] = sum;
+            sum += hist[p][d];
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            dst[next[((src[i] - min_key) >> shift) & (RADIX - 1)]++] = src[i];
+        }
+
+        std::swap(src, dst);
+    }
+
+    if (src != keys) {
+        std::copy(src, src + n, keys);
+    }
+}
+
+
+void bucket_sort(params_t& pr)
+{
+    const size_t mype = shmem_my_pe();
+    const size_t npes = shmem_n_pes();
+    const size_t tid  = omp_get_thread_num();
+
+    shmem_ctx_t ctx_amo, ctx_put;
+
+    if (pr.use_ctx) {
+        shmem_ctx_create(SHMEM_CTX_PRIVATE, &ctx_amo);
+        shmem_ctx_quiet(ctx_amo);
+
+        if (pr.use_pipelining) {
+            shmem_ctx_create(SHMEM_CTX_PRIVATE, &ctx_put);
+            shmem_ctx_quiet(ctx_put);
+        } else {
+            ctx_put = ctx_amo;
+        }
+
+    } else {
+        ctx_amo = SHMEM_CTX_DEFAULT;
+        ctx_put = SHMEM_CTX_DEFAULT;
+    }
+
+    const size_t gtid = mype * pr.n_threads + tid;
+
+    trace_ring* trace = pr.traces.empty() ? nullptr : &pr.traces[tid];
+
+    std::mt19937_64 rng(gtid);
+
+    // With regenerated keys, the keys of the next iteration are bucketed into
+    // the other half of these while the current half is being sent
+    const size_t n_halves = pr.use_regen ? 2 : 1;
+    size_t cur = 0;
+
+    std::vector<key_type> keys(pr.n_keys_th);
+    std::vector<size_t> local_bucket_sizes[2];
+    std::vector<size_t> send_buffer_offsets[2];
+    std::unique_ptr<key_type[]> send_buffer[2];
+
+    for (size_t h = 0; h < n_halves; h++) {
+        local_bucket_sizes[h].resize(pr.n_buckets);
+        send_buffer_offsets[h].resize(pr.n_buckets);
+        send_buffer[h] = std::make_unique<key_type[]>(pr.n_keys_th);
+    }
+
+    // Generate random keys and increase the local counter for the corresponding bucket
+    if (pr.use_regen) {
+        generate_keys(pr, 0, gtid, 0, pr.n_keys_th, keys.data(), local_bucket_sizes[0].data());
+    } else {
+        for (size_t i = 0; i < pr.n_keys_th; i++) {
+            keys[i] = draw_key(pr.dist, rng());
+            local_bucket_sizes[0][bucket_of(pr, keys[i])]++;
+        }
+    }
+
+    // The keys of all the iterations come from the same distribution, so the
+    // splitters of the first ones hold for all of them
+    if (pr.use_splitters) {
+        const timer::ticks ts = timer::now();
+
+        select_splitters(pr, keys.data(), tid, npes);
+
+        std::fill(local_bucket_sizes[0].begin(), local_bucket_sizes[0].end(), 0);
+        for (size_t i = 0; i < pr.n_keys_th; i++) {
+            local_bucket_sizes[0][bucket_of(pr, keys[i])]++;
+        }
+
+        #pragma omp barrier
+        #pragma omp master
+        T_sample_pe = timer::ms(timer::now() - ts);
+    }
+
+    // Store the random all-to-all schedules if needed
+    std::vector<size_t> shuffled_pes(npes);
+    for (size_t p = 0; p < npes; p++) {
+        shuffled_pes[p] = p;
+    }
+
+    // Steps of the send loop, the pairwise exchange needs a power of two of
+    // them and skips the PEs that don't exist, the hierarchical and Bruck
+    // schedules have their own
+    size_t n_steps = npes;
+
+    if (pr.comm == Sched::Pairwise) {
+        n_steps = 1;
+        while (n_steps < npes) {
+            n_steps *= 2;
+        }
+    } else if ((pr.comm == Sched::Hierarchical) || (pr.comm == Sched::Bruck)) {
+        n_steps = 0;
+    }
+
+    // Create and fill the bucketed send buffer
+    pack_keys(pr, keys.data(), local_bucket_sizes[0].data(), send_buffer_offsets[0].data(), send_buffer[0].get());
+
+    const size_t warmup_iters = std::max(size_t(20), pr.iters / 10);
+
+    timer::ticks t0 = 0, t1 = 0, t2 = 0;
+
+    // Time spent in the communication calls of the send stage
+    timer::ticks t_comm = 0;
+
+    // The rows of this thread in T_iters
+    double* T_th = &T_iters[gtid * N_TIMES * T_stride];
+    std::fill(T_th, T_th + N_TIMES * T_stride, 0.0);
+
+    // Scratch space of the local sort
+    const size_t bucket_len = size_t(pr.n_keys_th * pr.mem_scale);
+    std::vector<key_type> sort_tmp(pr.use_sort ? bucket_len : 0);
+    std::vector<uint32_t> sort_counts;
+
+    // The records of the encoded keys, one per bucket, kept until the quiet
+    std::vector<uint32_t> wire_out(pr.encode != Encode::None ? pr.n_keys_th + RECORD_EXTRA_WORDS * pr.n_buckets : 0);
+
+    // Bytes of keys sent in the last iteration
+    size_t sent_bytes = 0;
+
+    // Begin all-to-all key exchange
+    for (size_t i = 0; i < pr.iters + warmup_iters; i++) {
+        // Clear the counters
+        pr.recv_offsets[tid] = 0;
+
+        if (pr.encode != Encode::None) {
+            pr.wire_offsets[tid] = 0;
+        }
+
+        sent_bytes = (pr.encode == Encode::None) ? pr.n_keys_th * sizeof(key_type) : 0;
+        size_t wire_used = 0;
+
+        // Only the iterations after the warmup are timed
+        const bool timed = (i >= warmup_iters);
+        const size_t k   = i - warmup_iters;
+
+        // Generate a new random all-to-all schedule if random scheduling is enabled
+        if (pr.comm == Sched::Random) {
+            std::shuffle(shuffled_pes.begin(), shuffled_pes.end(), rng);
+        }
+
+        #pragma omp barrier
+        #pragma omp master
+        shmem_barrier_all();
+        #pragma omp barrier
+
+        const size_t nxt = cur ^ 1;
+
+        if (pr.use_regen) {
+            std::fill(local_bucket_sizes[nxt].begin(), local_bucket_sizes[nxt].end(), 0);
+        }
+
+        // Start the timer
+        t0 = timer::now();
+        t_comm = 0;
+
+        if (pr.use_a2a_offsets && (n_steps > 0)) {
+            reserve_offsets(pr, local_bucket_sizes[cur].data(), tid, npes);
+
+            t_comm += timer::now() - t0;
+        }
+
+        if (pr.comm == Sched::Hierarchical) {
+            hier_gather(pr, local_bucket_sizes[cur].data(), send_buffer_offsets[cur].data(), send_buffer[cur].get(), tid);
+            hier_send(pr, ctx_put, tid, trace, i);
+
+            t_comm += timer::now() - t0;
+
+            // Generate the next keys while the messages are in flight
+            if (pr.use_regen) {
+                generate_keys(pr, i + 1, gtid, 0, pr.n_keys_th, keys.data(), local_bucket_sizes[nxt].data());
+            }
+        }
+
+        if (pr.comm == Sched::Bruck) {
+            const timer::ticks tb = timer::now();
+
+            // Generate a slice of the next keys in every round, while the
+            // message of the round is in flight
+            timer::ticks t_gen = 0;
+
+            bruck_exchange(pr, local_bucket_sizes[cur].data(), send_buffer_offsets[cur].data(), send_buffer[cur].get(),
+                           ctx_put, tid, i + 1, trace,
+                           [&](const size_t r) {
+                               if (pr.use_regen) {
+                                   const timer::ticks tg = timer::now();
+
+                                   generate_keys(pr, i + 1, gtid, r * pr.n_keys_th / pr.bruck_rounds,
+                                                 (r + 1) * pr.n_keys_th / pr.bruck_rounds,
+                                                 keys.data(), local_bucket_sizes[nxt].data());
+
+                                   t_gen += timer::now() - tg;
+                               }
+                           });
+
+            // With a single PE there are no rounds
+            if (pr.use_regen && (pr.bruck_rounds == 0)) {
+                generate_keys(pr, i + 1, gtid, 0, pr.n_keys_th, keys.data(), local_bucket_sizes[nxt].data());
+            }
+
+            t_comm += timer::now() - tb - t_gen;
+        }
+
+        // Send keys
+        for (size_t _p = 0; _p < n_steps; _p++) {
+            size_t p;
+
+            switch (pr.comm) {
+                case Sched::Incast:
+                    p = _p;
+                    break;
+                case Sched::RoundRobin:
+                    p = (mype + _p) % npes;
+                    break;
+                case Sched::Pairwise:
+                    p = mype ^ _p;
+                    break;
+                default:
+                    p = shuffled_pes[_p];
+                    break;
+            }
+
+            const timer::ticks tc = timer::now();
+
+            for (size_t t = 0; (t < pr.n_threads) && (p < npes); t++) {
+                const size_t bucket_id   = p * pr.n_threads + t;
+                const size_t send_offset = send_buffer_offsets[cur][bucket_id];
+                const size_t send_size   = local_bucket_sizes[cur][bucket_id];
+
+                if (pr.encode != Encode::None) {
+                    if (send_size == 0) {
+                        continue;
+                    }
+
+                    uint32_t* record = &wire_out[wire_used];
+                    const size_t n_words = encode_record(pr, bucket_id, &send_buffer[cur][send_offset], send_size, record);
+                    wire_used += n_words;
+
+                    const timer::ticks ta    = trace ? timer::now() : 0;
+                    const size_t recv_offset = shmem_ctx_size_atomic_fetch_add(ctx_amo, &pr.wire_offsets[t], n_words, p);
+                    const timer::ticks tb    = trace ? timer::now() : 0;
+
+                    // A wire buffer too small for the records, raise -m
+                    assert(recv_offset + n_words <= pr.wire_len);
+
+                    if (pr.use_nbi) {
+                        shmem_ctx_putmem_nbi(ctx_put, &pr.wire[t][recv_offset], record, n_words * sizeof(uint32_t), p);
+                    } else {
+                        shmem_ctx_putmem(ctx_put, &pr.wire[t][recv_offset], record, n_words * sizeof(uint32_t), p);
+                    }
+
+                    if (trace) {
+                        trace->record(trace_kind::FetchAdd, ta, tb, p, i, sizeof(size_t));
+                        trace->record(trace_kind::Put, tb, timer::now(), p, i, n_words * sizeof(uint32_t));
+                    }
+
+                    sent_bytes += n_words * sizeof(uint32_t);
+                    continue;
+                }
+
+                const timer::ticks ta    = trace ? timer::now() : 0;
+                const size_t recv_offset = pr.use_a2a_offsets
+                                         ? pr.a2a_offsets_in[p * pr.n_threads * pr.n_threads + t * pr.n_threads + tid]
+                                         : shmem_ctx_size_atomic_fetch_add(ctx_amo, &pr.recv_offsets[t], send_size, p);
+                const timer::ticks tb    = trace ? timer::now() : 0;
+
+                // A bucket too small for the keys, raise -m
+                assert(recv_offset + send_size <= bucket_len);
+
+                if (pr.use_nbi) {
+                    shmem_ctx_putmem_nbi(ctx_put, &pr.buckets[t][recv_offset], &send_buffer[cur][send_offset], send_size * sizeof(key_type), p);
+                } else {
+                    shmem_ctx_putmem(ctx_put, &pr.buckets[t][recv_offset], &send_buffer[cur][send_offset], send_size * sizeof(key_type), p);
+                }
+
+                if (trace) {
+                    if (!pr.use_a2a_offsets) {
+                        trace->record(trace_kind::FetchAdd, ta, tb, p, i, sizeof(size_t));
+                    }
+                    trace->record(trace_kind::Put, tb, timer::now(), p, i, send_size * sizeof(key_type));
+                }
+            }
+
+            t_comm += timer::now() - tc;
+
+            // While the puts to p are in flight, generate the slice of the
+            // keys of the next iteration that goes with p
+            if (pr.use_regen) {
+                generate_keys(pr, i + 1, gtid, _p * pr.n_keys_th / n_steps, (_p + 1) * pr.n_keys_th / n_steps,
+                              keys.data(), local_bucket_sizes[nxt].data());
+            }
+        }
+
+        // The next keys are all there, bucket them before waiting for the puts
+        if (pr.use_regen) {
+            pack_keys(pr, keys.data(), local_bucket_sizes[nxt].data(), send_buffer_offsets[nxt].data(), send_buffer[nxt].get());
+        }
+
+        const timer::ticks tq = timer::now();
+
+        // Ensure remote completion
+        shmem_ctx_quiet(ctx_put);
+
+        if (trace) {
+            trace->record(trace_kind::Quiet, tq, timer::now(), TRACE_ALL_PES, i, 0);
+        }
+
+        // Once the messages of all the nodes are there
+        if (pr.comm == Sched::Hierarchical) {
+            #pragma omp barrier
+            #pragma omp master
+            shmem_barrier_all();
+            #pragma omp barrier
+
+            hier_scatter(pr, tid);
+        }
+
+        t1 = timer::now();
+
+        t_comm += t1 - tq;
+
+        if (timed) {
+            T_th[TIME_COMM * T_stride + k]  = timer::ms(t_comm);
+            T_th[TIME_CYCLE * T_stride + k] = timer::ms(t1 - t0);
+        }
+
+        #pragma omp barrier
+        #pragma omp master
+        shmem_sync_all();
+        #pragma omp barrier
+
+        // Decoding the keys that came in is part of the exchange
+        if (pr.encode != Encode::None) {
+            const timer::ticks td = timer::now();
+
+            decode_bucket(pr, tid, gtid, bucket_len);
+
+            if (timed) {
+                const double ms = timer::ms(timer::now() - td);
+
+                T_th[TIME_COMM * T_stride + k]  += ms;
+                T_th[TIME_CYCLE * T_stride + k] += ms;
+            }
+        }
+
+        // Make sure that there were no overflow
+        assert(pr.recv_offsets[tid] <= bucket_len);
+
+        const bool verify = (pr.verify == Verify::Every) ||
+                            ((pr.verify == Verify::Last) && (i + 1 == pr.iters + warmup_iters));
+
+        // Make sure that every thread received something (may fail for small numbers of keys)
+        assert(!verify || (pr.recv_offsets[tid] > 0));
+
+        const key_type my_min_key = pr.bounds[gtid];
+        const key_type my_max_key = pr.bounds[gtid + 1];
+        const size_t my_width     = my_max_key - my_min_key;
+
+        // Rank the keys of our bucket, narrow ranges are cheaper to count
+        if (pr.use_sort) {
+            t1 = timer::now();
+
+            if (my_width <= COUNT_SORT_MAX_WIDTH) {
+                counting_sort(pr.buckets[tid], pr.recv_offsets[tid], my_min_key, my_width, sort_counts);
+            } else {
+                radix_sort(pr.buckets[tid], sort_tmp.data(), pr.recv_offsets[tid], my_min_key, my_width, pr.use_simd);
+            }
+
+            t2 = timer::now();
+
+            if (timed) {
+                T_th[TIME_SORT * T_stride + k] = timer::ms(t2 - t1);
+            }
+        }
+
+        // Verify that all keys in our bucket are within range, and sorted,
+        // and that all the buckets got all their keys
+        if (verify) {
+            assert(check_bucket(pr.buckets[tid], pr.recv_offsets[tid], my_min_key, my_max_key, pr.use_sort));
+
+            check_counts(pr, local_bucket_sizes[cur].data(), tid, npes);
+        }
+
+        if (pr.use_regen) {
+            cur = nxt;
+        }
+    }
+
+    shmem_putmem(T_th, T_th, N_TIMES * T_stride * sizeof(double), 0);
+    shmem_size_p(&pr.bucket_keys[gtid], pr.recv_offsets[tid], 0);
+    shmem_size_p(&pr.wire_bytes[gtid], sent_bytes, 0);
+
+    if (pr.use_ctx) {
+        shmem_ctx_destroy(ctx_amo);
+
+        if (pr.use_pipelining) {
+            shmem_ctx_destroy(ctx_put);
+        }
+    }
+}
+
+
+void cleanup_params(params_t& pr)
+{
+    for (auto p : pr.buckets) {
+        shmem_free(p);
+    }
+
+    shmem_free(pr.recv_offsets);
+    shmem_free(pr.sent_keys);
+    shmem_free(pr.total_sent_keys);
+    shmem_free(pr.pWrk_verify);
+    shmem_free(pr.a2a_counts);
+    shmem_free(pr.a2a_counts_in);
+    shmem_free(pr.a2a_offsets);
+    shmem_free(pr.a2a_offsets_in);
+    shmem_free(pr.node_counts);
+    shmem_free(pr.stage_out);
+    shmem_free(pr.stage_in);
+    shmem_free(pr.bruck_in);
+    shmem_free(pr.bruck_flags);
+    shmem_free(pr.samples);
+    shmem_free(pr.all_samples);
+    shmem_free(pr.bucket_keys);
+    shmem_free(pr.wire_bytes);
+
+    for (auto p : pr.wire) {
+        shmem_free(p);
+    }
+
+    shmem_free(pr.wire_offsets);
+    shmem_free(T_iters);
+}
+
+
+// Statistics of one kind of time over all the threads, per iteration and then
+// averaged over the iterations, the imbalance of an iteration is its largest
+// time over its mean time
+struct time_stats {
+    double min, max, mean, p99, imbalance;
+    // Sum over all the threads and iterations, and over the iterations of
+    // every thread
+    double total;
+    std::vector<double> thread_total;
+};
+
+
+// On PE 0, once the rows of all the threads are there
+time_stats iter_stats(const params_t& pr, const int kind)
+{
+    time_stats st = {};
+    st.thread_total.assign(pr.n_buckets, 0.0);
+
+    std::vector<double> v(pr.n_buckets);
+
+    for (size_t k = 0; k < pr.iters; k++) {
+        double sum = 0.0;
+
+        for (size_t g = 0; g < pr.n_buckets; g++) {
+            v[g] = T_iters[(g * N_TIMES + kind) * T_stride + k];
+            st.thread_total[g] += v[g];
+            sum += v[g];
+        }
+
+        const double mean = sum / pr.n_buckets;
+
+        std::sort(v.begin(), v.end());
+
+        st.min       += v.front();
+        st.max       += v.back();
+        st.mean      += mean;
+        st.p99       += v[size_t(std::ceil(0.99 * pr.n_buckets)) - 1];
+        st.imbalance += (mean > 0.0) ? v.back() / mean : 1.0;
+        st.total     += sum;
+    }
+
+    st.min       /= pr.iters;
+    st.max       /= pr.iters;
+    st.mean      /= pr.iters;
+    st.p99       /= pr.iters;
+    st.imbalance /= pr.iters;
+
+    return st;
+}
+
+
+int main(int argc, char** argv)
+{
+    params_t pr;
+
+    pr.iters           = 50;
+    pr.n_threads       = 1;
+    pr.use_ctx         = false;
+    pr.use_nbi         = false;
+    pr.use_pipelining  = false;
+    pr.use_sort        = true;
+    pr.use_simd        = false;
+    pr.use_regen       = false;
+    pr.use_a2a_offsets = false;
+    pr.comm            = Sched::RoundRobin;
+    pr.auto_comm       = false;
+    pr.dist            = Dist::Uniform;
+    pr.use_splitters   = false;
+    pr.verify          = Verify::Every;
+    pr.encode          = Encode::None;
+    pr.n_keys          = 1UL << 29;
+    pr.n_keys_th       = 0;
+    pr.pes_per_node    = 0;
+    pr.mem_scale       = 1.2;
+    pr.fmt             = reporter::format::Table;
+
+    // Exit in case anything goes wrong
+    if (parse_args(argc, argv, pr)) {
+        return 1;
+    }
+
+    for (int i = 0; i < SHMEM_REDUCE_SYNC_SIZE; i++) {
+        pSync[i] = SHMEM_SYNC_VALUE;
+    }
+
+    for (int i = 0; i < SHMEM_ALLTOALL_SYNC_SIZE; i++) {
+        pSync_a2a[0][i] = SHMEM_SYNC_VALUE;
+        pSync_a2a[1][i] = SHMEM_SYNC_VALUE;
+    }
+
+    for (int i = 0; i < SHMEM_BARRIER_SYNC_SIZE; i++) {
+        pSync_node[i] = SHMEM_SYNC_VALUE;
+    }
+
+    for (int i = 0; i < SHMEM_COLLECT_SYNC_SIZE; i++) {
+        pSync_collect[i] = SHMEM_SYNC_VALUE;
+    }
+
+    for (int i = 0; i < SHMEM_REDUCE_SYNC_SIZE; i++) {
+        pSync_verify[i] = SHMEM_SYNC_VALUE;
+    }
+
+    int tl, tl_supported;
+
+    if (pr.n_threads == 1) {
+        tl = SHMEM_THREAD_FUNNELED;
+    } else {
+        tl = SHMEM_THREAD_MULTIPLE;
+    }
+
+    timer::init();
+    reporter::init("isx", pr.fmt);
+
+    shmem_init_thread(tl, &tl_supported);
+
+    if (tl != tl_supported) {
+        if (shmem_my_pe() == 0) {
+            std::cout << "Error: Could not enable the desired thread level!\n";
+        }
+        shmem_global_exit(1);
+    }
+
+    const size_t mype = shmem_my_pe();
+    const size_t npes = shmem_n_pes();
+
+    if ((pr.comm == Sched::Hierarchical) && init_nodes(pr, npes)) {
+        shmem_global_exit(1);
+    }
+
+    init_params(pr, npes);
+
+    // The encodings need the buckets of the flat schedules, and offsets that
+    // are known only when the records are packed
+    if ((pr.encode != Encode::None) &&
+        (pr.use_a2a_offsets || (pr.comm == Sched::Hierarchical) || (pr.comm == Sched::Bruck))) {
+        if (mype == 0) {
+            std::cout << "Error: the encodings need the round robin, incast, random or pairwise schedule, without -a\n";
+        }
+        shmem_global_exit(1);
+    }
+
+    reporter::set("pes", npes);
+    reporter::set("threads_per_pe", pr.n_threads);
+    reporter::set("keys", pr.n_keys);
+    reporter::set("keys_per_thread", pr.n_keys_th);
+    reporter::set("iters", pr.iters);
+    reporter::set("ctx", pr.use_ctx);
+    reporter::set("nbi", pr.use_nbi);
+    reporter::set("pipelining", pr.use_pipelining);
+    reporter::set("offsets", pr.use_a2a_offsets ? "alltoall" : "fetch_add");
+    reporter::set("regenerate_keys", pr.use_regen);
+    reporter::set("local_sort", pr.use_sort);
+    reporter::set("simd_histogram", pr.use_simd);
+    reporter::set("schedule", sched_name(pr.comm));
+    reporter::set("schedule_auto", pr.auto_comm);
+    reporter::set("distribution", dist_name(pr.dist));
+    reporter::set("splitters", pr.use_splitters);
+    reporter::set("verify", verify_name(pr.verify));
+    reporter::set("encode", encode_name(pr.encode));
+    reporter::set("pes_per_node", pr.pes_per_node);
+    reporter::set("mem_scale", pr.mem_scale);
+    reporter::set("timer", timer::source());
 
     if (mype == 0) {
-        std::cout << "Starting benchmark on " << npes << " PEs, " << pr.n_threads
-                  << " threads/PE, sorting " << pr.n_keys << " keys for "
-                  << pr.iters << " iteration(s)\n";
+        reporter::text() << "Starting benchmark on " << npes << " PEs, " << pr.n_threads
+                         << " threads/PE, sorting " << pr.n_keys << " keys for "
+                         << pr.iters << " iteration(s)\n";
+    }
+
+    if (!pr.trace_prefix.empty()) {
+        pr.traces.resize(pr.n_threads);
+
+        shmem_barrier_all();
+        trace_origin = timer::now();
+    }
+
+    #pragma omp parallel num_threads(pr.n_threads) default(none) shared(pr)
+    bucket_sort(pr);
+
+    if (!pr.trace_prefix.empty()) {
+        const std::string path = pr.trace_prefix + "." + std::to_string(mype) + ".bin";
+
+        if (!write_trace(path.c_str(), mype, npes, pr.traces, trace_origin)) {
+            std::cout << "Error: PE " << mype << " could not write " << path << "\n";
+        }
     }
 
-    #pragma omp parallel num_threads(pr.n_threads) default(none) shared(pr, T_pe)
-    bucket_sort(pr, T_pe);
+    shmem_double_max_to_all(&T_sample_max, &T_sample_pe, 1, 0, 0, npes, pWrk, pSync);
 
-    shmem_double_sum_to_all(&T_sum, &T_pe, 1, 0, 0, npes, pWrk, pSync);
+    shmem_barrier_all();
 
+    // The throughput counts an average send stage plus the sort
     if (mype == 0) {
-        std::cout << "Cumulative all-to-all time (sec)           : " << T_sum / 1000.0
-                  << "\nAverage all-to-all time per iteration (ms) : "
-                  << T_sum / pr.n_buckets / pr.iters
-                  << '\n';
+        const time_stats comm  = iter_stats(pr, TIME_COMM);
+        const time_stats cycle = iter_stats(pr, TIME_CYCLE);
+        const time_stats sort  = iter_stats(pr, TIME_SORT);
+
+        // The largest bucket over the average one, 1 is a perfect balance
+        const size_t max_bucket = *std::max_element(pr.bucket_keys, pr.bucket_keys + pr.n_buckets);
+        const double imbalance  = max_bucket / (double(pr.n_keys) / pr.n_buckets);
+
+        // With the headers of the records, 4 when the keys are not encoded
+        const size_t wire_bytes = std::accumulate(pr.wire_bytes, pr.wire_bytes + pr.n_buckets, size_t(0));
+
+        record r;
+        r.add("total_s", comm.total / 1000.0, 6)
+         .add("iter_avg_ms", comm.mean, 6)
+         .add("iter_min_ms", comm.min, 6)
+         .add("iter_max_ms", comm.max, 6)
+         .add("iter_p99_ms", comm.p99, 6)
+         .add("imbalance", comm.imbalance)
+         .add("cycle_iter_avg_ms", cycle.mean, 6)
+         .add("cycle_iter_max_ms", cycle.max, 6)
+         .add("cycle_imbalance", cycle.imbalance)
+         .add("sort_total_s", sort.total / 1000.0, 6)
+         .add("sort_iter_avg_ms", sort.mean, 6)
+         .add("sort_iter_max_ms", sort.max, 6)
+         .add("sort_imbalance", sort.imbalance)
+         .add("keys_per_s", pr.n_keys / ((cycle.mean + sort.mean) / 1000.0), 0)
+         .add("bucket_imbalance", imbalance)
+         .add("wire_bytes_per_key", double(wire_bytes) / pr.n_keys)
+         .add("sample_ms", T_sample_max)
+         .add("thread_ms", comm.thread_total)
+         .add("sort_thread_ms", sort.thread_total);
+        reporter::emit(r);
     }
 
     cleanup_params(pr);
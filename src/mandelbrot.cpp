@@ -1,18 +1,160 @@
+#include <algorithm>
 #include <iostream>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
-#include <chrono>
 #include <memory>
+#include <random>
 #include <vector>
 
+#include <omp.h>
 #include <shmem.h>
 #include <getopt.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#include "reporter.hpp"
+#include "timer.hpp"
+#include "wait.hpp"
+
+
+// Kernels that compute the pixels of a job, the SIMD ones run 4 (AVX2) or 8
+// (AVX-512) pixels at once and give the same values as the scalar one, since
+// they do the same double operations in the same order
+enum class Kernel {
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+const char* kernel_name(const Kernel k)
+{
+    switch (k) {
+        case Kernel::Avx2:
+            return "avx2";
+        case Kernel::Avx512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+bool kernel_supported(const Kernel k)
+{
+    switch (k) {
+#ifdef HAVE_X86_KERNELS
+        case Kernel::Avx2:
+            return __builtin_cpu_supports("avx2");
+        case Kernel::Avx512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        case Kernel::Scalar:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The widest kernel that the CPU runs
+Kernel best_kernel()
+{
+    for (const Kernel k : {Kernel::Avx512, Kernel::Avx2}) {
+        if (kernel_supported(k)) {
+            return k;
+        }
+    }
+
+    return Kernel::Scalar;
+}
+
+
+// Points that are known not to escape, and so take all max_iters, can be
+// skipped without changing the image:
+//   None: every point runs until it escapes or reaches max_iters
+//   Bulb: the points well inside the main cardioid or the period-2 bulb are
+//         not iterated at all
+//   Period: Bulb, and an orbit stops as soon as it comes back exactly to a
+//           point that it went through, checked against the point of the last
+//           power-of-two iteration (Brent), it would cycle forever
+enum class Skip {
+    None,
+    Bulb,
+    Period
+};
+
+const char* skip_name(const Skip s)
+{
+    switch (s) {
+        case Skip::Bulb:
+            return "bulb";
+        case Skip::Period:
+            return "period";
+        default:
+            return "none";
+    }
+}
+
+// The interior test must hold by this much, so that rounding can't let a point
+// just outside of the cardioid or the bulb through
+#define INTERIOR_MARGIN 1e-12
+
+
+// Order in which a thread steals jobs from the PEs:
+//   RoundRobin: one job from every PE that still has some in turn, starting
+//               after its own PE, all with SHMEM fetch-adds
+//   Hierarchical: its own PE until it has no jobs left, then the other PEs of
+//                 its node, then the other nodes in a random order, so that
+//                 the threads don't all go for the same remote PEs at once
+// The CPU atomics and the SHMEM AMOs on a counter are not atomic with each
+// other when the network does the AMOs, so the counters of the node are
+// updated with CPU atomics, through shmem_ptr, only when all the PEs are on
+// the node and every PE reaches all of them, and with SHMEM AMOs like the
+// others otherwise
+enum class Steal {
+    RoundRobin,
+    Hierarchical
+};
+
+const char* steal_name(const Steal s)
+{
+    switch (s) {
+        case Steal::Hierarchical:
+            return "hierarchical";
+        default:
+            return "round_robin";
+    }
+}
+
+// Where the jobs that a thread got came from
+enum {
+    STEAL_LOCAL,
+    STEAL_NODE,
+    STEAL_REMOTE,
+    N_STEALS
+};
+
 
 struct config {
-    size_t w, h, job_len;
+    // With guided self-scheduling, job_len is the shortest job, and a job is
+    // the points that its victim has left over the number of threads, so the
+    // jobs start long and get shorter towards the end, up to max_job_len
+    // With a queue_len, the threads take jobs from a queue of their PE, which
+    // steals blocks of queue_len points for them, guided or not
+    size_t w, h, job_len, max_job_len, queue_len;
+    bool guided;
+    // Nodes of the hierarchical stealing, made of consecutive PEs, and
+    // whether their counters are updated with CPU atomics
+    size_t pes_per_node;
+    bool cpu_atomics;
     uint16_t max_iters, n_threads;
     bool use_nbi, use_ctx, use_pipelining, save_img;
+    Kernel kernel;
+    Skip skip;
+    Steal steal;
+    reporter::format fmt;
 };
 
 
@@ -50,7 +192,7 @@ public:
 
         for (int i = 0; i < 2; i++) {
             for (int j = 0; j < 2; j++) {
-                ctx_buf[i][j] = std::make_unique<uint16_t[]>(cf.job_len);
+                ctx_buf[i][j] = std::make_unique<uint16_t[]>(cf.max_job_len);
             }
         }
     }
@@ -91,30 +233,271 @@ double total_wr = 0.0;
 double local_t  = 0.0;
 double local_wr = 0.0;
 
+// Whether a PE reaches all the PEs with shmem_ptr, and whether all of them do
+double local_reach = 0.0;
+double all_reach   = 0.0;
+
+// Jobs that were computed, steals by where they came from, and atomics issued
+// for the steals, summed over the threads
+double total_jobs = 0.0;
+double local_jobs = 0.0;
+double total_steals[N_STEALS];
+double local_steals[N_STEALS];
+double total_amos = 0.0;
+double local_amos = 0.0;
+
+// Runtime and work rate of every thread, gathered on PE 0
+double* thread_t;
+double* thread_wr;
+
+
+// The compiler may not fuse the multiplications and additions of the pixel
+// math into FMAs, it would do so only where the target has them, and then the
+// kernels and the builds would not give the same image
+#define NO_FMA __attribute__((optimize("fp-contract=off")))
+
 
-uint16_t compute_pixel(const config cf, const size_t w)
+// The point of the complex plane of pixel w
+NO_FMA inline void pixel_coords(const config& cf, const size_t w, double& x0, double& y0)
 {
     const size_t cx = w % cf.w;
     const size_t cy = w / cf.w;
-    const double x0 = -2.5 + cx * (4.0 / cf.w);
-    const double y0 = -2.0 + cy * (4.0 / cf.h);
+
+    x0 = -2.5 + cx * (4.0 / cf.w);
+    y0 = -2.0 + cy * (4.0 / cf.h);
+}
+
+
+// Whether x0 + i y0 is inside the main cardioid or the period-2 bulb, with
+// INTERIOR_MARGIN to spare
+NO_FMA inline bool in_interior(const double x0, const double y0)
+{
+    const double y2 = y0 * y0;
+    const double xq = x0 - 0.25;
+    const double q  = xq * xq + y2;
+
+    const bool cardioid = q * (q + xq) < 0.25 * y2 - INTERIOR_MARGIN;
+    const bool bulb     = (x0 + 1.0) * (x0 + 1.0) + y2 < 0.0625 - INTERIOR_MARGIN;
+
+    return cardioid || bulb;
+}
+
+
+NO_FMA uint16_t compute_pixel(const config cf, const size_t w)
+{
+    double x0, y0;
+    pixel_coords(cf, w, x0, y0);
+
+    if ((cf.skip != Skip::None) && in_interior(x0, y0)) {
+        return 0;
+    }
+
+    const bool period = (cf.skip == Skip::Period);
+
     double x = 0.0;
     double y = 0.0;
     double x2 = x * x;
     double y2 = y * y;
 
+    // The point of the orbit at iteration next_save / 2
+    double xs = x;
+    double ys = y;
+    uint32_t next_save = 1;
+
     uint16_t i;
     for (i = 0; (i < cf.max_iters) && (x2 + y2 < 4.0); i++) {
         y = 2 * x * y + y0;
         x = x2 - y2 + x0;
         x2 = x * x;
         y2 = y * y;
+
+        if (period) {
+            if ((x == xs) && (y == ys)) {
+                return 0;
+            }
+
+            if (i + 1U == next_save) {
+                xs = x;
+                ys = y;
+                next_save *= 2;
+            }
+        }
     }
 
     return cf.max_iters - i;
 }
 
 
+#ifdef HAVE_X86_KERNELS
+
+// Four pixels per vector, a lane stops counting once its point escapes or
+// reaches max_iters, and the vector runs until all the lanes have stopped
+NO_FMA __attribute__((target("avx2")))
+void compute_job_avx2(const config& cf, const size_t w_start, const size_t w_end, uint16_t* buf)
+{
+    const __m256d two   = _mm256_set1_pd(2.0);
+    const __m256d four  = _mm256_set1_pd(4.0);
+    const __m256d one   = _mm256_set1_pd(1.0);
+    const __m256d limit = _mm256_set1_pd(cf.max_iters);
+    const bool period   = (cf.skip == Skip::Period);
+
+    size_t w = w_start;
+
+    for (; w + 4 <= w_end; w += 4) {
+        alignas(32) double x0s[4], y0s[4], counts[4];
+
+        // The interior points start out done
+        for (size_t l = 0; l < 4; l++) {
+            pixel_coords(cf, w + l, x0s[l], y0s[l]);
+            counts[l] = ((cf.skip != Skip::None) && in_interior(x0s[l], y0s[l])) ? cf.max_iters : 0.0;
+        }
+
+        const __m256d x0 = _mm256_load_pd(x0s);
+        const __m256d y0 = _mm256_load_pd(y0s);
+
+        __m256d x  = _mm256_setzero_pd();
+        __m256d y  = _mm256_setzero_pd();
+        __m256d x2 = _mm256_setzero_pd();
+        __m256d y2 = _mm256_setzero_pd();
+        __m256d i  = _mm256_load_pd(counts);
+        __m256d xs = x;
+        __m256d ys = y;
+
+        // All the lanes start together, so they save their points together
+        uint32_t n_iters   = 0;
+        uint32_t next_save = 1;
+
+        __m256d active = _mm256_cmp_pd(i, limit, _CMP_LT_OQ);
+
+        while (_mm256_movemask_pd(active) != 0) {
+            y  = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, x), y), y0);
+            x  = _mm256_add_pd(_mm256_sub_pd(x2, y2), x0);
+            x2 = _mm256_mul_pd(x, x);
+            y2 = _mm256_mul_pd(y, y);
+            i  = _mm256_add_pd(i, _mm256_and_pd(active, one));
+
+            if (period) {
+                const __m256d back = _mm256_and_pd(_mm256_cmp_pd(x, xs, _CMP_EQ_OQ), _mm256_cmp_pd(y, ys, _CMP_EQ_OQ));
+                i = _mm256_blendv_pd(i, limit, _mm256_and_pd(active, back));
+
+                if (++n_iters == next_save) {
+                    xs = x;
+                    ys = y;
+                    next_save *= 2;
+                }
+            }
+
+            active = _mm256_and_pd(active, _mm256_cmp_pd(i, limit, _CMP_LT_OQ));
+            active = _mm256_and_pd(active, _mm256_cmp_pd(_mm256_add_pd(x2, y2), four, _CMP_LT_OQ));
+        }
+
+        _mm256_store_pd(counts, i);
+
+        for (size_t l = 0; l < 4; l++) {
+            buf[w + l - w_start] = cf.max_iters - uint16_t(counts[l]);
+        }
+    }
+
+    for (; w < w_end; w++) {
+        buf[w - w_start] = compute_pixel(cf, w);
+    }
+}
+
+
+// Eight pixels per vector, with the lanes that still run in a mask register
+NO_FMA __attribute__((target("avx512f")))
+void compute_job_avx512(const config& cf, const size_t w_start, const size_t w_end, uint16_t* buf)
+{
+    const __m512d two   = _mm512_set1_pd(2.0);
+    const __m512d four  = _mm512_set1_pd(4.0);
+    const __m512d one   = _mm512_set1_pd(1.0);
+    const __m512d limit = _mm512_set1_pd(cf.max_iters);
+    const bool period   = (cf.skip == Skip::Period);
+
+    size_t w = w_start;
+
+    for (; w + 8 <= w_end; w += 8) {
+        alignas(64) double x0s[8], y0s[8], counts[8];
+
+        for (size_t l = 0; l < 8; l++) {
+            pixel_coords(cf, w + l, x0s[l], y0s[l]);
+            counts[l] = ((cf.skip != Skip::None) && in_interior(x0s[l], y0s[l])) ? cf.max_iters : 0.0;
+        }
+
+        const __m512d x0 = _mm512_load_pd(x0s);
+        const __m512d y0 = _mm512_load_pd(y0s);
+
+        __m512d x  = _mm512_setzero_pd();
+        __m512d y  = _mm512_setzero_pd();
+        __m512d x2 = _mm512_setzero_pd();
+        __m512d y2 = _mm512_setzero_pd();
+        __m512d i  = _mm512_load_pd(counts);
+        __m512d xs = x;
+        __m512d ys = y;
+
+        uint32_t n_iters   = 0;
+        uint32_t next_save = 1;
+
+        __mmask8 active = _mm512_cmp_pd_mask(i, limit, _CMP_LT_OQ);
+
+        while (active != 0) {
+            y  = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, x), y), y0);
+            x  = _mm512_add_pd(_mm512_sub_pd(x2, y2), x0);
+            x2 = _mm512_mul_pd(x, x);
+            y2 = _mm512_mul_pd(y, y);
+            i  = _mm512_mask_add_pd(i, active, i, one);
+
+            if (period) {
+                const __mmask8 back = _mm512_mask_cmp_pd_mask(_mm512_mask_cmp_pd_mask(active, x, xs, _CMP_EQ_OQ),
+                                                              y, ys, _CMP_EQ_OQ);
+                i = _mm512_mask_mov_pd(i, back, limit);
+
+                if (++n_iters == next_save) {
+                    xs = x;
+                    ys = y;
+                    next_save *= 2;
+                }
+            }
+
+            active = _mm512_mask_cmp_pd_mask(active, i, limit, _CMP_LT_OQ);
+            active = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(x2, y2), four, _CMP_LT_OQ);
+        }
+
+        _mm512_store_pd(counts, i);
+
+        for (size_t l = 0; l < 8; l++) {
+            buf[w + l - w_start] = cf.max_iters - uint16_t(counts[l]);
+        }
+    }
+
+    for (; w < w_end; w++) {
+        buf[w - w_start] = compute_pixel(cf, w);
+    }
+}
+
+#endif
+
+
+// Compute the pixels [w_start, w_end) into buf with the kernel of cf
+void compute_job(const config& cf, const size_t w_start, const size_t w_end, uint16_t* buf)
+{
+    switch (cf.kernel) {
+#ifdef HAVE_X86_KERNELS
+        case Kernel::Avx2:
+            compute_job_avx2(cf, w_start, w_end, buf);
+            return;
+        case Kernel::Avx512:
+            compute_job_avx512(cf, w_start, w_end, buf);
+            return;
+#endif
+        default:
+            for (size_t w = w_start; w < w_end; w++) {
+                buf[w - w_start] = compute_pixel(cf, w);
+            }
+    }
+}
+
+
 void save_image(const config cf,
                 const uint16_t* image,
                 const size_t npes,
@@ -136,7 +519,7 @@ void save_image(const config cf,
 
     shmem_quiet();
 
-    std::cout << "Saving the image...\n";
+    reporter::text() << "Saving the image...\n";
 
     std::ofstream f("mandelbrot.pgm", std::ios::out);
 
@@ -153,6 +536,237 @@ void save_image(const config cf,
 }
 
 
+// What a worker knows of the PEs it steals from, a worker is a thread, or all
+// the threads of a PE with the queue, where only the thread that refills the
+// queue touches it
+struct steal_state {
+    size_t mype, node_first;
+    std::vector<bool> pe_mask;
+    size_t pe_pending, victim_pe;
+
+    // The hierarchical order of the victims, and the counters of the PEs of
+    // the node, a null one is stolen from with SHMEM
+    std::vector<size_t> victims;
+    size_t next_victim;
+    std::vector<size_t*> counters;
+
+    // Guided: the last value seen of the counter of every PE, where the
+    // compare-and-swap of the next job from it starts
+    std::vector<size_t> w_seen;
+
+    size_t steals[N_STEALS];
+    size_t amos;
+};
+
+
+size_t steal_kind(const config& cf, const steal_state& st, const size_t pe)
+{
+    if (pe == st.mype) {
+        return STEAL_LOCAL;
+    }
+
+    return ((pe >= st.node_first) && (pe < st.node_first + cf.pes_per_node)) ? STEAL_NODE : STEAL_REMOTE;
+}
+
+
+// The remote victims are shuffled with seed
+void init_steal(const config& cf, steal_state& st, const size_t mype, const size_t npes,
+                const std::vector<size_t>& w_pes_min, size_t* w_next, const uint64_t seed)
+{
+    st.mype        = mype;
+    st.node_first  = mype / cf.pes_per_node * cf.pes_per_node;
+    st.pe_pending  = npes;
+    st.victim_pe   = mype;
+    st.next_victim = 0;
+    st.w_seen      = w_pes_min;
+    st.amos        = 0;
+
+    st.pe_mask.assign(npes, true);
+    st.counters.assign(npes, nullptr);
+    std::fill(st.steals, st.steals + N_STEALS, 0);
+
+    if (cf.steal == Steal::Hierarchical) {
+        st.victims.push_back(mype);
+        st.counters[mype] = cf.cpu_atomics ? w_next : nullptr;
+
+        for (size_t k = 1; k < cf.pes_per_node; k++) {
+            const size_t pe = st.node_first + (mype - st.node_first + k) % cf.pes_per_node;
+
+            st.victims.push_back(pe);
+            st.counters[pe] = cf.cpu_atomics ? (size_t*)shmem_ptr(w_next, pe) : nullptr;
+        }
+
+        const size_t n_local = st.victims.size();
+
+        for (size_t pe = 0; pe < npes; pe++) {
+            if (steal_kind(cf, st, pe) == STEAL_REMOTE) {
+                st.victims.push_back(pe);
+            }
+        }
+
+        std::mt19937_64 rng(seed);
+        std::shuffle(st.victims.begin() + n_local, st.victims.end(), rng);
+    }
+}
+
+
+// Claim a job of len points from the next victim that has some left, or of
+// at least len points with guided self-scheduling among n_workers, the job
+// is [w_start, w_end) of PE pe
+// Returns false once all the PEs are out of jobs
+bool steal_job(const config& cf, steal_state& st, shmem_ctx_t ctx, size_t* w_next,
+               const std::vector<size_t>& w_pes_max, const size_t n_workers, const size_t len,
+               size_t& pe, size_t& w_start, size_t& w_end)
+{
+    const size_t npes = st.pe_mask.size();
+
+    while (st.pe_pending != 0) {
+        if (cf.steal == Steal::Hierarchical) {
+            while (!st.pe_mask[st.victims[st.next_victim]]) {
+                st.next_victim++;
+            }
+            st.victim_pe = st.victims[st.next_victim];
+        } else {
+            do {
+                st.victim_pe = (st.victim_pe + 1) % npes;
+            } while (!st.pe_mask[st.victim_pe]);
+        }
+
+        const size_t victim = st.victim_pe;
+
+        // A guided job is the points left over n_workers
+        auto guided_len = [&](const size_t w_from) {
+            const size_t left = (w_from < w_pes_max[victim]) ? w_pes_max[victim] - w_from : 0;
+            return std::max(len, (left + n_workers - 1) / n_workers);
+        };
+
+        size_t job       = len;
+        bool   fetch_add = true;
+
+        if (cf.guided) {
+            // The last value this thread saw of the counter is usually
+            // behind, and a job computed from it would be too long, so it is
+            // only claimed if the compare-and-swap finds the counter there
+            // Otherwise the swap returns the current value, and the job that
+            // is computed from it is claimed with a fetch-add, so that a
+            // claim takes up to two atomics
+            w_start = st.w_seen[victim];
+            job     = guided_len(w_start);
+
+            size_t old = w_start;
+
+            if (st.counters[victim] != nullptr) {
+                __atomic_compare_exchange_n(st.counters[victim], &old, w_start + job, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            } else {
+                old = shmem_ctx_size_atomic_compare_swap(ctx, w_next, w_start, w_start + job, victim);
+            }
+
+            st.amos++;
+
+            if (old == w_start) {
+                fetch_add = false;
+            } else {
+                w_start   = old;
+                job       = guided_len(w_start);
+                fetch_add = (w_start < w_pes_max[victim]);
+            }
+        }
+
+        if (fetch_add) {
+            // Don't use ctx for this one
+            w_start = (st.counters[victim] != nullptr)
+                    ? __atomic_fetch_add(st.counters[victim], job, __ATOMIC_RELAXED)
+                    : shmem_ctx_size_atomic_fetch_add(ctx, w_next, job, victim);
+
+            st.amos++;
+        }
+
+        w_end = w_start + job;
+
+        st.w_seen[victim] = w_end;
+
+        if (w_start >= w_pes_max[victim]) {
+            st.pe_pending--;
+            st.pe_mask[victim] = false;
+            continue;
+        } else if (w_end >= w_pes_max[victim]) {
+            w_end = w_pes_max[victim];
+            st.pe_pending--;
+            st.pe_mask[victim] = false;
+        }
+
+        st.steals[steal_kind(cf, st, victim)]++;
+        pe = victim;
+
+        return true;
+    }
+
+    return false;
+}
+
+
+// Take a job of job_len points from the queue of the threads of a PE, which
+// is the block of points that the PE stole last, with a CPU fetch-add on
+// queue: the end of the block in the upper 32 bits, the next point in the
+// lower ones. The thread whose fetch-add is the first to go past the end
+// steals the next block with pe_steal, at least queue_len points with one
+// SHMEM atomic, or up to two when guided, and publishes it, while the
+// threads that come after it wait for the end to change. done is set once
+// there is nothing left to steal.
+// Returns false once all the PEs are out of jobs
+bool queue_job(const config& cf, uint64_t& queue, bool& done, steal_state& pe_steal,
+               shmem_ctx_t ctx, size_t* w_next, const std::vector<size_t>& w_pes_max,
+               size_t& pe, size_t& w_start, size_t& w_end)
+{
+    const size_t npes = w_pes_max.size();
+
+    for (;;) {
+        const uint64_t q   = __atomic_fetch_add(&queue, cf.job_len, __ATOMIC_ACQ_REL);
+        const size_t next  = q & 0xffffffffUL;
+        const size_t b_end = q >> 32;
+
+        if (next < b_end) {
+            w_start = next;
+            w_end   = std::min(next + cf.job_len, b_end);
+            pe      = std::upper_bound(w_pes_max.begin(), w_pes_max.end(), next) - w_pes_max.begin();
+
+            return true;
+        }
+
+        if (next < b_end + cf.job_len) {
+            size_t block_end;
+
+            if (!steal_job(cf, pe_steal, ctx, w_next, w_pes_max, npes, cf.queue_len, pe, w_start, block_end)) {
+                __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+                return false;
+            }
+
+            w_end = std::min(w_start + cf.job_len, block_end);
+            __atomic_store_n(&queue, (uint64_t(block_end) << 32) | w_end, __ATOMIC_RELEASE);
+
+            return true;
+        }
+
+        // Like wait_kind::SpinYield, the thread that steals may share the core
+        size_t polls = 0;
+
+        while ((__atomic_load_n(&queue, __ATOMIC_ACQUIRE) >> 32) == b_end) {
+            if (__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+                return false;
+            }
+
+            if (polls < SPIN_POLLS) {
+                polls++;
+                cpu_relax();
+            } else {
+                sched_yield();
+            }
+        }
+    }
+}
+
+
 void draw_mandelbrot(const config cf)
 {
     const size_t mype = shmem_my_pe();
@@ -176,68 +790,98 @@ void draw_mandelbrot(const config cf)
 
     auto image = (uint16_t*)shmem_malloc(sizeof(uint16_t) * (w_quot + w_rmdr));
 
+    thread_t  = (double*)shmem_malloc(sizeof(double) * npes * cf.n_threads);
+    thread_wr = (double*)shmem_malloc(sizeof(double) * npes * cf.n_threads);
+
     shmem_barrier_all();
 
+    reporter::set("pes", npes);
+    reporter::set("threads_per_pe", cf.n_threads);
+    reporter::set("width", cf.w);
+    reporter::set("height", cf.h);
+    reporter::set("job_len", cf.job_len);
+    reporter::set("guided", cf.guided);
+    reporter::set("queue_len", cf.queue_len);
+    reporter::set("max_iters", cf.max_iters);
+    reporter::set("ctx", cf.use_ctx);
+    reporter::set("nbi", cf.use_nbi);
+    reporter::set("pipelining", cf.use_pipelining);
+    reporter::set("kernel", kernel_name(cf.kernel));
+    reporter::set("skip", skip_name(cf.skip));
+    reporter::set("steal", steal_name(cf.steal));
+    reporter::set("pes_per_node", cf.pes_per_node);
+    reporter::set("cpu_atomics", cf.cpu_atomics);
+    reporter::set("timer", timer::source());
+
     if (mype == 0)
-        std::cout << "Starting benchmark on " << npes << " PEs, " << cf.n_threads
-                  << " threads/PE, image size: " << cf.w << " x " << cf.h
-                  << '\n' << cf.job_len << " points per job, with a maximum of "
-                  << cf.max_iters << " iterations per point\n";
+        reporter::text() << "Starting benchmark on " << npes << " PEs, " << cf.n_threads
+                         << " threads/PE, image size: " << cf.w << " x " << cf.h
+                         << '\n' << (cf.guided ? "at least " : "") << cf.job_len
+                         << " points per job, with a maximum of "
+                         << cf.max_iters << " iterations per point\n";
+
+    // With the queue, the threads of the PE share its stealing
+    steal_state pe_steal;
+    uint64_t queue  = 0;
+    bool queue_done = false;
+
+    if (cf.queue_len > 0) {
+        init_steal(cf, pe_steal, mype, npes, w_pes_min, &w_next, mype);
+    }
 
     #pragma omp parallel num_threads(cf.n_threads)          \
                          default(none)                      \
                          firstprivate(image, cf, npes, mype)\
-                         shared(w_next, w_pes_min, w_pes_max, local_t, local_wr)
+                         shared(w_next, w_pes_min, w_pes_max, local_t, local_wr, \
+                                local_jobs, local_steals, local_amos, thread_t, thread_wr, \
+                                pe_steal, queue, queue_done)
     {
         comm_env cv(cf);
 
-        auto pe_mask = std::make_unique<bool[]>(npes);
-        for (size_t i = 0; i < npes; i++)
-            pe_mask[i] = true;
+        const size_t tid = omp_get_thread_num();
+
+        steal_state own_steal;
+
+        if (cf.queue_len == 0) {
+            init_steal(cf, own_steal, mype, npes, w_pes_min, &w_next, mype * cf.n_threads + tid);
+        }
 
         #pragma omp barrier
         #pragma omp master
         shmem_barrier_all();
         #pragma omp barrier
 
-        size_t pe_pending = npes;
-        size_t victim_pe  = mype;
         size_t total_work = 0;
+        size_t jobs       = 0;
 
-        const auto t_start = std::chrono::steady_clock::now();
+        const auto t_start = timer::now();
 
-        while (pe_pending != 0) {
-            do {
-                victim_pe = (victim_pe + 1) % npes;
-            } while (!pe_mask[victim_pe]);
+        for (;;) {
+            size_t pe, w_start, w_end;
 
-            // Don't use ctx for this one
-            const size_t w_start = shmem_ctx_size_atomic_fetch_add(cv.ctx(), &w_next, cf.job_len, victim_pe);
-            size_t w_end = w_start + cf.job_len;
-
-            if (w_start >= w_pes_max[victim_pe]) {
-                pe_pending--;
-                pe_mask[victim_pe] = false;
-                continue;
-            } else if (w_end >= w_pes_max[victim_pe]) {
-                w_end = w_pes_max[victim_pe];
-                pe_pending--;
-                pe_mask[victim_pe] = false;
+            const bool found = (cf.queue_len > 0)
+                             ? queue_job(cf, queue, queue_done, pe_steal, cv.ctx(), &w_next, w_pes_max,
+                                         pe, w_start, w_end)
+                             : steal_job(cf, own_steal, cv.ctx(), &w_next, w_pes_max, npes * cf.n_threads,
+                                         cf.job_len, pe, w_start, w_end);
+
+            if (!found) {
+                break;
             }
 
             auto buf = cv.buf();
 
-            for (size_t w = w_start; w < w_end; w++)
-                buf[w - w_start] = compute_pixel(cf, w);
+            compute_job(cf, w_start, w_end, buf);
 
             if (cf.use_nbi) {
                 shmem_ctx_quiet(cv.ctx());
-                shmem_ctx_uint16_put_nbi(cv.ctx(), &image[w_start - w_pes_min[victim_pe]], buf, w_end - w_start, victim_pe);
+                shmem_ctx_uint16_put_nbi(cv.ctx(), &image[w_start - w_pes_min[pe]], buf, w_end - w_start, pe);
             } else {
-                shmem_ctx_uint16_put(cv.ctx(), &image[w_start - w_pes_min[victim_pe]], buf, w_end - w_start, victim_pe);
+                shmem_ctx_uint16_put(cv.ctx(), &image[w_start - w_pes_min[pe]], buf, w_end - w_start, pe);
             }
 
             total_work += w_end - w_start;
+            jobs++;
 
             cv.advance();
         }
@@ -249,14 +893,35 @@ void draw_mandelbrot(const config cf)
             shmem_ctx_quiet(cv.ctx());
         }
 
-        const auto t_end = std::chrono::steady_clock::now();
-        const double t = std::chrono::duration<double>(t_end - t_start).count();
+        const auto t_end = timer::now();
+        const double t = timer::s(t_end - t_start);
 
         #pragma omp atomic
         local_t += t;
 
         #pragma omp atomic
         local_wr += total_work / t;
+
+        #pragma omp atomic
+        local_jobs += jobs;
+
+        // The steals of the queue are counted once, the thread that set
+        // queue_done made them all visible
+        if ((cf.queue_len == 0) || (tid == 0)) {
+            const steal_state& st = (cf.queue_len > 0) ? pe_steal : own_steal;
+
+            for (size_t k = 0; k < N_STEALS; k++) {
+                #pragma omp atomic
+                local_steals[k] += st.steals[k];
+            }
+
+            #pragma omp atomic
+            local_amos += st.amos;
+        }
+
+        const size_t th = mype * cf.n_threads + omp_get_thread_num();
+        shmem_double_p(&thread_t[th], t, 0);
+        shmem_double_p(&thread_wr[th], total_work / t, 0);
     }
 
     shmem_double_sum_to_all(&total_t, &local_t, 1, 0, 0, npes, pWrk, pSync);
@@ -265,12 +930,36 @@ void draw_mandelbrot(const config cf)
 
     shmem_double_sum_to_all(&total_wr, &local_wr, 1, 0, 0, npes, pWrk, pSync);
 
+    shmem_barrier_all();
+
+    shmem_double_sum_to_all(total_steals, local_steals, N_STEALS, 0, 0, npes, pWrk, pSync);
+
+    shmem_barrier_all();
+
+    shmem_double_sum_to_all(&total_amos, &local_amos, 1, 0, 0, npes, pWrk, pSync);
+
+    shmem_barrier_all();
+
+    shmem_double_sum_to_all(&total_jobs, &local_jobs, 1, 0, 0, npes, pWrk, pSync);
+
     if (mype == 0) {
-        std::cout << "Total cumulative runtime (sec)        : " << total_t
-                  << "\nAverage thread runtime (sec)          : " << total_t / (npes * cf.n_threads)
-                  << "\nTotal work rate (points/sec)          : " << total_wr
-                  << "\nAverage thread work rate (points/sec) : " << total_wr / (npes * cf.n_threads)
-                  << '\n';
+        const size_t n_th = npes * cf.n_threads;
+        const double steals = total_steals[STEAL_LOCAL] + total_steals[STEAL_NODE] + total_steals[STEAL_REMOTE];
+
+        record r;
+        r.add("total_s", total_t, 6)
+         .add("thread_avg_s", total_t / n_th, 6)
+         .add("points_per_s", total_wr, 0)
+         .add("thread_avg_points_per_s", total_wr / n_th, 0)
+         .add("jobs", size_t(total_jobs))
+         .add("steals", size_t(steals))
+         .add("amos", size_t(total_amos))
+         .add("local_steal_share", total_steals[STEAL_LOCAL] / steals)
+         .add("node_steal_share", total_steals[STEAL_NODE] / steals)
+         .add("remote_steal_share", total_steals[STEAL_REMOTE] / steals)
+         .add("thread_s", std::vector<double>(thread_t, thread_t + n_th))
+         .add("thread_points_per_s", std::vector<double>(thread_wr, thread_wr + n_th));
+        reporter::emit(r);
     }
 
     if (cf.save_img && (mype == 0))
@@ -279,6 +968,8 @@ void draw_mandelbrot(const config cf)
     shmem_barrier_all();
 
     shmem_free(image);
+    shmem_free(thread_t);
+    shmem_free(thread_wr);
 }
 
 
@@ -288,12 +979,33 @@ void print_help(const config cf)
               << "    -t <n_threads>  number of OpenMP threads per PE (default:" << cf.n_threads << ")\n"
               << "    -i <iterations> maximum iterations per point (default:" << cf.max_iters << ")\n"
               << "    -j <job_len>    load balancing granularity (default:" << cf.job_len << ")\n"
+              << "    -g              guided self-scheduling, a job is the points that are left on\n"
+              << "                    its PE over the number of threads, and at least -j points\n"
+              << "                    (default: disabled)\n"
               << "    -w <width>      width of the Mandelbrot image (default:" << cf.w << ")\n"
               << "    -h <height>     height of the Mandelbrot image (default:" << cf.h << ")\n"
               << "    -c              use contexts (default: disabled)\n"
               << "    -b              use blocking puts (default: disabled)\n"
               << "    -p              enable pipelining (implies -c) (default: disabled)\n"
-              << "    -o              save the Mandelbrot image (default: disabled)\n";
+              << "    -o              save the Mandelbrot image (default: disabled)\n"
+              << "    -k <kernel>     pixel kernel, scalar, avx2, avx512 or auto, the widest one\n"
+              << "                    that the CPU runs (default: auto)\n"
+              << "    -x <skip>       skip the points that never escape without changing the image,\n"
+              << "                    none, bulb (main cardioid and period-2 bulb) or period (bulb,\n"
+              << "                    and orbits that come back to a point) (default: " << skip_name(cf.skip) << ")\n"
+              << "    -q <queue_len>  the threads of a PE take jobs from a shared queue, which steals\n"
+              << "                    blocks of queue_len points for them, 0 for every thread to\n"
+              << "                    steal on its own (default: " << cf.queue_len << ")\n"
+              << "    -s <steal>      order of the victims of the steals, round_robin, or\n"
+              << "                    hierarchical: own PE, then node, then the other nodes in a\n"
+              << "                    random order, with CPU atomics within the node only when\n"
+              << "                    all the PEs can use them, see -l, since they are not atomic\n"
+              << "                    with the SHMEM ones (default: " << steal_name(cf.steal) << ")\n"
+              << "    -l <pes>        PEs per node, consecutive, stolen from with CPU atomics only\n"
+              << "                    when all the PEs are on one node and shmem_ptr reaches all\n"
+              << "                    of them, and with SHMEM otherwise (default: all the PEs\n"
+              << "                    that shmem_ptr can reach)\n"
+              << "    -f <format>     output format, table, json or csv (default: table)\n";
 }
 
 
@@ -304,19 +1016,30 @@ int main(int argc, char** argv)
     cf.w              = 32000;
     cf.h              = 32000;
     cf.job_len        = 400;
+    cf.guided         = false;
+    cf.queue_len      = 0;
     cf.max_iters      = 1000;
     cf.n_threads      = 1;
     cf.use_nbi        = true;
     cf.use_ctx        = false;
     cf.use_pipelining = false;
     cf.save_img       = false;
+    cf.kernel         = best_kernel();
+    cf.skip           = Skip::None;
+    cf.steal          = Steal::RoundRobin;
+    cf.pes_per_node   = 0;
+    cf.cpu_atomics    = false;
+    cf.fmt            = reporter::format::Table;
 
     int c;
-    while ((c = getopt(argc, argv, "cbpow:h:t:j:i:")) != -1) {
+    while ((c = getopt(argc, argv, "cbpgow:h:t:j:q:i:k:x:s:l:f:")) != -1) {
         switch (c) {
             case 'o':
                 cf.save_img = true;
                 break;
+            case 'g':
+                cf.guided = true;
+                break;
             case 'w':
                 cf.w = std::atoi(optarg);
                 break;
@@ -329,6 +1052,9 @@ int main(int argc, char** argv)
             case 'j':
                 cf.job_len = std::atoi(optarg);
                 break;
+            case 'q':
+                cf.queue_len = std::atol(optarg);
+                break;
             case 'i':
                 cf.max_iters = std::atoi(optarg);
                 break;
@@ -342,6 +1068,68 @@ int main(int argc, char** argv)
                 cf.use_ctx = true;
                 cf.use_pipelining = true;
                 break;
+            case 'k':
+                {
+                    bool found = (std::strcmp(optarg, "auto") == 0);
+
+                    if (found) {
+                        cf.kernel = best_kernel();
+                    }
+
+                    for (const Kernel k : {Kernel::Scalar, Kernel::Avx2, Kernel::Avx512}) {
+                        if (std::strcmp(optarg, kernel_name(k)) == 0) {
+                            cf.kernel = k;
+                            found = true;
+                        }
+                    }
+
+                    if (!found) {
+                        print_help(cf);
+                        return 1;
+                    }
+
+                    if (!kernel_supported(cf.kernel)) {
+                        std::cout << "Error: this CPU can't run the " << kernel_name(cf.kernel) << " kernel\n";
+                        return 1;
+                    }
+                    break;
+                }
+            case 'x':
+                {
+                    bool found = false;
+
+                    for (const Skip k : {Skip::None, Skip::Bulb, Skip::Period}) {
+                        if (std::strcmp(optarg, skip_name(k)) == 0) {
+                            cf.skip = k;
+                            found = true;
+                        }
+                    }
+
+                    if (!found) {
+                        print_help(cf);
+                        return 1;
+                    }
+                    break;
+                }
+            case 's':
+                if (std::strcmp(optarg, steal_name(Steal::RoundRobin)) == 0) {
+                    cf.steal = Steal::RoundRobin;
+                } else if (std::strcmp(optarg, steal_name(Steal::Hierarchical)) == 0) {
+                    cf.steal = Steal::Hierarchical;
+                } else {
+                    print_help(cf);
+                    return 1;
+                }
+                break;
+            case 'l':
+                cf.pes_per_node = std::atoi(optarg);
+                break;
+            case 'f':
+                if (!reporter::parse_format(optarg, cf.fmt)) {
+                    print_help(cf);
+                    return 1;
+                }
+                break;
             default:
                 print_help(cf);
                 return 1;
@@ -359,6 +1147,9 @@ int main(int argc, char** argv)
         tl = SHMEM_THREAD_MULTIPLE;
     }
 
+    timer::init();
+    reporter::init("mandelbrot", cf.fmt);
+
     shmem_init_thread(tl, &tl_supported);
 
     if (tl != tl_supported) {
@@ -368,6 +1159,57 @@ int main(int argc, char** argv)
         shmem_global_exit(1);
     }
 
+    const size_t npes = shmem_n_pes();
+
+    if (cf.pes_per_node == 0) {
+        for (size_t p = 0; p < npes; p++) {
+            if (shmem_ptr(pSync, p) != nullptr) {
+                cf.pes_per_node++;
+            }
+        }
+    }
+
+    if ((cf.pes_per_node == 0) || (npes % cf.pes_per_node != 0)) {
+        if (shmem_my_pe() == 0) {
+            std::cout << "Error: can't split " << npes << " PEs into nodes of " << cf.pes_per_node << " PEs\n";
+        }
+        shmem_global_exit(1);
+    }
+
+    // No PE may update a counter with SHMEM while another one updates it with
+    // the CPU, so all of them have to be able to use the CPU atomics
+    size_t n_reached = 0;
+
+    for (size_t p = 0; p < npes; p++) {
+        if (shmem_ptr(pSync, p) != nullptr) {
+            n_reached++;
+        }
+    }
+
+    local_reach = ((cf.pes_per_node == npes) && (n_reached == npes)) ? 1.0 : 0.0;
+
+    shmem_double_min_to_all(&all_reach, &local_reach, 1, 0, 0, npes, pWrk, pSync);
+
+    shmem_barrier_all();
+
+    cf.cpu_atomics = (all_reach == 1.0);
+
+    // The first job of the PE with the most points is the longest one
+    const size_t n_points = cf.w * cf.h;
+    const size_t pe_max   = n_points / npes + n_points % npes;
+    const size_t n_th     = npes * cf.n_threads;
+
+    cf.max_job_len = (cf.guided && (cf.queue_len == 0)) ? std::max(cf.job_len, (pe_max + n_th - 1) / n_th) : cf.job_len;
+
+    // The queue packs the points in 32 bits, with room for the fetch-adds of
+    // the threads that go past the end of a block
+    if ((cf.queue_len > 0) && (n_points + cf.n_threads * cf.job_len > 0xffffffffUL)) {
+        if (shmem_my_pe() == 0) {
+            std::cout << "Error: the queue can't hold the points of a " << cf.w << " x " << cf.h << " image\n";
+        }
+        shmem_global_exit(1);
+    }
+
     draw_mandelbrot(cf);
 
     shmem_finalize();
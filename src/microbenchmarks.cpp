@@ -0,0 +1,1723 @@
+// Latency: do one communication call and one quiet in every iteration
+// Message Rate: do communication calls in a loop, then call quiet once
+//
+// All the benchmarks run between two nodes and are templated on the execution
+// model (see exec_model.hpp), which is selected at run time with --model.
+
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+#include <getopt.h>
+#include <unistd.h>
+#include <shmem.h>
+#include <omp.h>
+
+#include "exec_model.hpp"
+#include "histogram.hpp"
+#include "reporter.hpp"
+#include "timer.hpp"
+
+
+#define TH_SEG_LEN_LOG 20
+#define TH_SEG_LEN (1UL << TH_SEG_LEN_LOG)
+
+#define N_WORKERS_MAX 64
+#define N_NODES_MAX 64
+
+// Largest number of outstanding operations of the streaming benchmarks
+#define MAX_WINDOW_LOG 10
+
+// Number of nodes, and of workers per node and per PE, decided by the execution
+// model
+size_t N_NODES, N_WORKERS, N_WORKERS_PE, SR_BUF_LEN, HEAP_LEN;
+
+// Workers publish their results here on the reporter PE, one row per quantity
+// and one slot per worker
+#define N_STATS 2
+double stats[N_STATS][N_NODES_MAX * N_WORKERS_MAX];
+
+// Latency histograms of the workers, merged by the reporter
+histogram hists[2 * N_WORKERS_MAX];
+
+
+// How the nodes pick their destinations in the multi-node benchmarks
+enum class pattern {
+    Pairwise,
+    Ring,
+    Random,
+    AllToAll
+};
+
+
+struct pattern_entry {
+    const char* name;
+    pattern pt;
+    const char* desc;
+};
+
+const pattern_entry PATTERNS[] = {
+    {"pairwise", pattern::Pairwise, "nodes (0, 1), (2, 3), ... exchange, the last of an odd count idles"},
+    {"ring",     pattern::Ring,     "node i sends to node i + 1"},
+    {"random",   pattern::Random,   "node i sends to node p(i) of a random permutation w/o fixed points"},
+    {"alltoall", pattern::AllToAll, "every node sends to all the other nodes in turn"},
+};
+
+
+// Run-time options shared by all the benchmarks
+struct config {
+    // Message sizes are swept in powers of two from 2^min_len_log to 2^max_len_log
+    size_t min_len_log, max_len_log;
+    // Outstanding operations of the streaming benchmarks are swept in powers of
+    // two from 2^min_window_log to 2^max_window_log
+    size_t min_window_log, max_window_log;
+    // Zero means using the default of each benchmark
+    size_t iters;
+    // Negative means using 1/10 of the iterations
+    long warm_up;
+    bool one_way, skip_stress;
+    pattern pt;
+    reporter::format fmt;
+    std::string model;
+    std::vector<std::string> benches;
+};
+
+
+// Pick the number of timed and warm-up iterations of a test, the command line
+// overrides the defaults of the benchmark
+void pick_iters(const config& cf, const size_t default_iter, size_t& iter, size_t& warm_up)
+{
+    iter = (cf.iters != 0) ? cf.iters : default_iter;
+
+    if (cf.warm_up < 0) {
+        warm_up = iter / 10;
+    } else {
+        warm_up = cf.warm_up;
+    }
+}
+
+
+// In one-way tests only the workers on node 1 communicate
+bool is_active(const worker& w, const config& cf)
+{
+    return !cf.one_way || (w.node == 1);
+}
+
+
+// Synchronize the workers that take part in a test, must only be called by
+// the active workers
+template <typename M>
+void sync_active(M& m, const worker& w, const config& cf)
+{
+    if (cf.one_way) {
+        m.node_barrier(w);
+    } else {
+        m.barrier();
+    }
+}
+
+
+struct summary {
+    double min, max, avg, sum;
+};
+
+
+// Compute the statistics of the values published by the active workers
+summary summarize(const double* slots, const config& cf)
+{
+    const size_t first = cf.one_way ? N_WORKERS : 0;
+    const size_t last  = 2 * N_WORKERS;
+
+    summary s;
+    s.min = slots[first];
+    s.max = slots[first];
+    s.avg = 0.0;
+
+    for (size_t i = first; i < last; i++) {
+        if (slots[i] < s.min) {
+            s.min = slots[i];
+        }
+
+        if (slots[i] > s.max) {
+            s.max = slots[i];
+        }
+
+        s.avg += slots[i];
+    }
+
+    s.sum = s.avg;
+    s.avg /= double(last - first);
+
+    return s;
+}
+
+
+// Ship the histogram of w to the reporter, completed by the next barrier
+template <typename M>
+void publish_hist(M& m, const worker& w, const histogram& h)
+{
+    shmem_ctx_putmem(w.ctx, &hists[w.idx], &h, sizeof(histogram), m.report_pe());
+    shmem_ctx_quiet(w.ctx);
+}
+
+
+// Merge the histograms published by the active workers
+histogram merge_hists(const config& cf)
+{
+    const size_t first = cf.one_way ? N_WORKERS : 0;
+    const size_t last  = 2 * N_WORKERS;
+
+    histogram h;
+    h.clear();
+
+    for (size_t i = first; i < last; i++) {
+        h.merge(hists[i]);
+    }
+
+    return h;
+}
+
+
+// The values published by the active workers, for the per-worker fields
+std::vector<double> active_slots(const double* slots, const config& cf)
+{
+    const size_t first = cf.one_way ? N_WORKERS : 0;
+    const size_t last  = 2 * N_WORKERS;
+
+    return std::vector<double>(slots + first, slots + last);
+}
+
+
+// Percentiles of the per-operation latency, in microseconds
+void add_percentiles(record& r, const histogram& h)
+{
+    r.add("p50_us", h.percentile(0.5) / 1000.0)
+     .add("p90_us", h.percentile(0.9) / 1000.0)
+     .add("p99_us", h.percentile(0.99) / 1000.0)
+     .add("p99.9_us", h.percentile(0.999) / 1000.0)
+     .add("p100_us", h.max() / 1000.0);
+}
+
+
+template <typename M>
+void stress_test(M& m, uint8_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        if (w.is_reporter) {
+            reporter::text() << "Stress test, time of the slowest worker in microseconds:\n";
+        }
+
+        // Every worker owns one segment of the send and the receive buffer
+        auto sbuf = heap + w.tid * TH_SEG_LEN;
+        auto rbuf = heap + SR_BUF_LEN + w.tid * TH_SEG_LEN;
+
+        auto amo_target = ((uint64_t*)heap) + 1;
+        uint64_t amo_result;
+
+        // The sum of the ranks of all the workers on a node
+        const uint64_t rank_sum = (N_WORKERS * (N_WORKERS - 1)) / 2;
+
+        timer::ticks t0 = 0, t1 = 0;
+
+        // Time of the slowest worker
+        auto report = [&](const char* test, const size_t msg_len) {
+            const double T = timer::us(t1 - t0);
+
+            m.publish(w, stats[0], T);
+            m.barrier();
+
+            if (w.is_reporter) {
+                config all = cf;
+                all.one_way = false;
+
+                record r;
+                r.add("size", msg_len)
+                 .add("test", test)
+                 .add("max_us", summarize(stats[0], all).max)
+                 .add("time_us", active_slots(stats[0], all));
+                reporter::emit(r);
+            }
+        };
+
+        for (size_t e = cf.min_len_log; e <= cf.max_len_log; e++) {
+            const size_t msg_len = 1UL << e;
+            const size_t n_msg   = TH_SEG_LEN >> e;
+
+            uint8_t this_put_pattern, that_put_pattern;
+            uint8_t this_get_pattern, that_get_pattern;
+
+            // Determine iteration-specific heap data patterns
+            if (w.node == 0) {
+                this_put_pattern = 11 + e;
+                that_put_pattern = 13 + e;
+                this_get_pattern = 17 + e;
+                that_get_pattern = 19 + e;
+            } else {
+                this_put_pattern = 13 + e;
+                that_put_pattern = 11 + e;
+                this_get_pattern = 19 + e;
+                that_get_pattern = 17 + e;
+            }
+
+
+            // Stage 1.1:
+            // Initialize the segments of this worker w/ different patterns on
+            // different nodes
+            for (size_t i = 0; i < TH_SEG_LEN; i++) {
+                sbuf[i] = i % this_put_pattern;
+                rbuf[i] = i % this_put_pattern;
+            }
+
+            m.barrier();
+
+            t0 = timer::now();
+
+            // Stage 1.2:
+            // Send this worker's send buffer to the receive buffer of its peer
+            // worker on the other node using blocking puts.
+            for (size_t i = 0; i < n_msg; i++) {
+                shmem_ctx_putmem(w.ctx, rbuf + i * msg_len, sbuf + i * msg_len, msg_len, w.peer_pe);
+            }
+
+            shmem_ctx_quiet(w.ctx);
+
+            t1 = timer::now();
+
+            m.barrier();
+
+            // Stage 1.3:
+            // Verify the result and reinitialize the segments
+            bool sbuf_ok = true;
+            bool rbuf_ok = true;
+
+            for (size_t i = 0; i < TH_SEG_LEN; i++) {
+                // Send buffer must be untouched
+                if (sbuf[i] != i % this_put_pattern) {
+                    sbuf_ok = false;
+                }
+
+                // Receive buffer must has the pattern of the other node
+                if (rbuf[i] != i % that_put_pattern) {
+                    rbuf_ok = false;
+                }
+            }
+
+            if (!sbuf_ok) {
+                std::cout << "** ERROR: incorrect sbuf in put test\n";
+            }
+
+            if (!rbuf_ok) {
+                std::cout << "** ERROR: incorrect rbuf in put test\n";
+            }
+
+            report("put", msg_len);
+
+            // Refill the buffer
+            for (size_t i = 0; i < TH_SEG_LEN; i++) {
+                sbuf[i] = i % this_get_pattern;
+                rbuf[i] = i % this_get_pattern;
+            }
+
+            m.barrier();
+
+            t0 = timer::now();
+
+            // Stage 2.1
+            // Fetch the send buffer of this worker's peer on the other node
+            // to its receive buffer using blocking gets.
+            for (size_t i = 0; i < n_msg; i++) {
+                shmem_ctx_getmem(w.ctx, rbuf + i * msg_len, sbuf + i * msg_len, msg_len, w.peer_pe);
+            }
+
+            shmem_ctx_quiet(w.ctx);
+
+            t1 = timer::now();
+
+            m.barrier();
+
+            // Stage 2.2
+            // Verify the result
+            sbuf_ok = true;
+            rbuf_ok = true;
+
+            for (size_t i = 0; i < TH_SEG_LEN; i++) {
+                // Send buffer must be untouched
+                if (sbuf[i] != i % this_get_pattern) {
+                    sbuf_ok = false;
+                }
+
+                // Receive buffer must has the pattern of the other node
+                if (rbuf[i] != i % that_get_pattern) {
+                    rbuf_ok = false;
+                }
+            }
+
+            if (!sbuf_ok) {
+                std::cout << "** ERROR: incorrect sbuf in get test\n";
+            }
+
+            if (!rbuf_ok) {
+                std::cout << "** ERROR: incorrect rbuf in get test\n";
+            }
+
+            report("get", msg_len);
+
+            // Stage 3.1
+            // Prepare the targets for atomic operations, the first worker of
+            // each node hosts the target of the other node
+            if (w.rank == 0) {
+                *amo_target = 0;
+            }
+
+            m.barrier();
+
+            t0 = timer::now();
+
+            // Stage 3.2
+            // All workers increment the same counter on the other node
+            // Result should be: msg_len * n_msg * N_WORKERS = TH_SEG_LEN * N_WORKERS
+            for (size_t i = 0; i < n_msg; i++) {
+                shmem_ctx_uint64_atomic_add(w.ctx, amo_target, msg_len, w.amo_pe);
+            }
+
+            shmem_ctx_quiet(w.ctx);
+
+            t1 = timer::now();
+
+            m.barrier();
+
+            // Stage 3.3
+            // Verify the result
+            if ((w.rank == 0) && (*amo_target != TH_SEG_LEN * N_WORKERS)) {
+                std::cout << "** ERROR: incorrect result in AMO ADD test"
+                          << "\n** Expected: " << TH_SEG_LEN * N_WORKERS
+                          << "\n** Received: " << *amo_target << '\n';
+            }
+
+            report("amo post", msg_len);
+
+            // Stage 4.1
+            // Prepare the targets for AMO FADD
+            if (w.rank == 0) {
+                *amo_target = 0;
+            }
+
+            m.barrier();
+
+            t0 = timer::now();
+
+            // Stage 4.2
+            // All workers increment the same counter on the other node using
+            // AMO fetch-add
+            for (size_t i = 0; i < n_msg; i++) {
+                amo_result = shmem_ctx_uint64_atomic_fetch_add(w.ctx, amo_target, msg_len, w.amo_pe);
+            }
+
+            shmem_ctx_quiet(w.ctx);
+
+            t1 = timer::now();
+
+            m.barrier();
+
+            // Stage 4.3
+            // Verify the result and prepare for the CSWAP test
+            if ((w.rank == 0) && (*amo_target != TH_SEG_LEN * N_WORKERS)) {
+                std::cout << "** ERROR: incorrect result in AMO FADD test"
+                          << "\n** Expected: " << TH_SEG_LEN * N_WORKERS
+                          << "\n** Received: " << *amo_target << '\n';
+            }
+
+            report("amo fadd", msg_len);
+
+            if (w.rank == 0) {
+                *amo_target = 0;
+            }
+
+            // Local counter for number of successful CSWAPs
+            uint64_t succ_loc = 0;
+
+            m.barrier();
+
+            t0 = timer::now();
+
+            // Stage 4.4
+            // All workers compete against each other to increment the same
+            // counter on the other node using AMO compare-and-swap
+            // The worker that is the furthest ahead always succeeds, so the
+            // counter reaches n_msg without keeping the workers in lockstep
+            for (size_t i = 0; i < n_msg; i++) {
+                amo_result = shmem_ctx_uint64_atomic_compare_swap(w.ctx, amo_target, i, i + 1, w.amo_pe);
+
+                // Did I succeed?
+                if (amo_result == i) {
+                    succ_loc++;
+                }
+            }
+
+            shmem_ctx_quiet(w.ctx);
+
+            t1 = timer::now();
+
+            m.barrier();
+
+            // Stage 4.5
+            // Verify the result and prepare for the SWAP test
+            m.publish(w, stats[1], succ_loc);
+
+            if ((w.rank == 0) && (*amo_target != n_msg)) {
+                std::cout << "** ERROR: incorrect result in AMO CSWAP test"
+                          << "\n** Expected: " << n_msg
+                          << "\n** Received: " << *amo_target << '\n';
+            }
+
+            report("amo cswap", msg_len);
+
+            if (w.is_reporter) {
+                for (size_t node = 0; node < 2; node++) {
+                    uint64_t succ = 0;
+                    for (size_t i = 0; i < N_WORKERS; i++) {
+                        succ += stats[1][node * N_WORKERS + i];
+                    }
+
+                    if (succ != n_msg) {
+                        std::cout << "** ERROR: incorrect number of successful AMO CSWAPs"
+                                  << "\n** Expected: " << n_msg
+                                  << "\n** Succeed: " << succ << '\n';
+                    }
+                }
+            }
+
+            // Assign the sum of the ranks to the common AMO target
+            if (w.rank == 0) {
+                *amo_target = rank_sum;
+            }
+
+            // Use the rank as the local value
+            amo_result = w.rank;
+
+            m.barrier();
+
+            t0 = timer::now();
+
+            // Stage 4.6
+            // All workers swap their local values with the same remote target
+            // There is no guarantee where will the sum reside at the end of
+            // the loop
+            // The sum of the number of times each worker owned the sum is also
+            // unpredictable, could be much bigger than n_msg
+            for (size_t i = 0; i < n_msg; i++) {
+                amo_result = shmem_ctx_uint64_atomic_swap(w.ctx, amo_target, amo_result, w.amo_pe);
+            }
+
+            shmem_ctx_quiet(w.ctx);
+
+            t1 = timer::now();
+
+            m.barrier();
+
+            // Stage 4.7
+            // Verify the result
+            // The local values of a node plus the value resting on the target
+            // of that node should be twice the sum of the ranks
+            m.publish(w, stats[1], amo_result);
+
+            report("amo swap", msg_len);
+
+            if (w.is_reporter) {
+                for (size_t node = 0; node < 2; node++) {
+                    uint64_t sum = shmem_uint64_atomic_fetch(amo_target, (1 - node) * m.report_pe());
+                    for (size_t i = 0; i < N_WORKERS; i++) {
+                        sum += stats[1][node * N_WORKERS + i];
+                    }
+
+                    if (sum != 2 * rank_sum) {
+                        std::cout << "** ERROR: incorrect result in AMO SWAP test"
+                                  << "\n** Expected: " << 2 * rank_sum
+                                  << "\n** Received: " << sum << '\n';
+                    }
+                }
+            }
+
+            m.barrier();
+        }
+    });
+}
+
+
+template <typename M>
+void bench_put_nbi(M& m, uint8_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        auto sbuf = heap + w.tid * TH_SEG_LEN;
+        auto rbuf = heap + SR_BUF_LEN + w.tid * TH_SEG_LEN;
+
+        if (w.is_reporter) {
+            reporter::text() << "Benchmarking " << (cf.one_way ? "unidirectional" : "bidirectional")
+                             << " non-blocking put, time unit microseconds:\n";
+        }
+
+        timer::ticks t0 = 0, t1 = 0, t2 = 0;
+
+        // Latency of every post & flush pair
+        histogram lat;
+
+        for (size_t e = cf.min_len_log; e <= cf.max_len_log; e++) {
+            const size_t msg_len = 1UL << e;
+
+            size_t iter, warm_up;
+
+            if (msg_len < (1UL << 17)) {
+                pick_iters(cf, 10000, iter, warm_up);
+            } else {
+                pick_iters(cf, 500, iter, warm_up);
+            }
+
+            double post_time = 0.0;
+            double wait_time = 0.0;
+
+            lat.clear();
+
+            if (is_active(w, cf)) {
+                sync_active(m, w, cf);
+
+                for (size_t i = 0; i < iter + warm_up; i++) {
+                    t0 = timer::now();
+
+                    shmem_ctx_putmem_nbi(w.ctx, rbuf, sbuf, msg_len, w.peer_pe);
+
+                    t1 = timer::now();
+
+                    shmem_ctx_quiet(w.ctx);
+
+                    t2 = timer::now();
+
+                    if (i >= warm_up) {
+                        post_time += timer::us(t1 - t0);
+                        wait_time += timer::us(t2 - t1);
+                        lat.record(uint64_t(timer::ns(t2 - t0)));
+                    }
+                }
+
+                post_time /= double(iter);
+                wait_time /= double(iter);
+
+                publish_hist(m, w, lat);
+            }
+
+            m.publish(w, stats[0], post_time);
+            m.publish(w, stats[1], wait_time);
+
+            m.barrier();
+
+            // Do statistics
+            if (w.is_reporter) {
+                const summary post = summarize(stats[0], cf);
+                const summary wait = summarize(stats[1], cf);
+
+                record r;
+                r.add("size", msg_len)
+                 .add("iters", iter)
+                 .add("post_min_us", post.min)
+                 .add("post_max_us", post.max)
+                 .add("post_avg_us", post.avg)
+                 .add("flush_min_us", wait.min)
+                 .add("flush_max_us", wait.max)
+                 .add("flush_avg_us", wait.avg);
+                add_percentiles(r, merge_hists(cf));
+                r.add("post_us", active_slots(stats[0], cf))
+                 .add("flush_us", active_slots(stats[1], cf));
+                reporter::emit(r);
+            }
+        }
+    });
+}
+
+
+template <typename M>
+void bench_get_nbi(M& m, uint8_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        auto sbuf = heap + w.tid * TH_SEG_LEN;
+        auto rbuf = heap + SR_BUF_LEN + w.tid * TH_SEG_LEN;
+
+        if (w.is_reporter) {
+            reporter::text() << "Benchmarking " << (cf.one_way ? "unidirectional" : "bidirectional")
+                             << " non-blocking get, time unit microseconds:\n";
+        }
+
+        timer::ticks t0 = 0, t1 = 0, t2 = 0;
+
+        // Latency of every post & flush pair
+        histogram lat;
+
+        for (size_t e = cf.min_len_log; e <= cf.max_len_log; e++) {
+            const size_t msg_len = 1UL << e;
+
+            size_t iter, warm_up;
+
+            if (msg_len < (1UL << 17)) {
+                pick_iters(cf, 10000, iter, warm_up);
+            } else {
+                pick_iters(cf, 500, iter, warm_up);
+            }
+
+            double post_time = 0.0;
+            double wait_time = 0.0;
+
+            lat.clear();
+
+            if (is_active(w, cf)) {
+                sync_active(m, w, cf);
+
+                for (size_t i = 0; i < iter + warm_up; i++) {
+                    t0 = timer::now();
+
+                    shmem_ctx_getmem_nbi(w.ctx, rbuf, sbuf, msg_len, w.peer_pe);
+
+                    t1 = timer::now();
+
+                    shmem_ctx_quiet(w.ctx);
+
+                    t2 = timer::now();
+
+                    if (i >= warm_up) {
+                        post_time += timer::us(t1 - t0);
+                        wait_time += timer::us(t2 - t1);
+                        lat.record(uint64_t(timer::ns(t2 - t0)));
+                    }
+                }
+
+                post_time /= double(iter);
+                wait_time /= double(iter);
+
+                publish_hist(m, w, lat);
+            }
+
+            m.publish(w, stats[0], post_time);
+            m.publish(w, stats[1], wait_time);
+
+            m.barrier();
+
+            // Do statistics
+            if (w.is_reporter) {
+                const summary post = summarize(stats[0], cf);
+                const summary wait = summarize(stats[1], cf);
+
+                record r;
+                r.add("size", msg_len)
+                 .add("iters", iter)
+                 .add("post_min_us", post.min)
+                 .add("post_max_us", post.max)
+                 .add("post_avg_us", post.avg)
+                 .add("flush_min_us", wait.min)
+                 .add("flush_max_us", wait.max)
+                 .add("flush_avg_us", wait.avg);
+                add_percentiles(r, merge_hists(cf));
+                r.add("post_us", active_slots(stats[0], cf))
+                 .add("flush_us", active_slots(stats[1], cf));
+                reporter::emit(r);
+            }
+        }
+    });
+}
+
+
+template <typename M>
+void bench_put(M& m, uint8_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        auto sbuf = heap + w.tid * TH_SEG_LEN;
+        auto rbuf = heap + SR_BUF_LEN + w.tid * TH_SEG_LEN;
+
+        if (w.is_reporter) {
+            reporter::text() << "Benchmarking " << (cf.one_way ? "unidirectional" : "bidirectional")
+                             << " blocking put, time unit microseconds:\n";
+        }
+
+        // t_prev is the end of the previous operation, so timing every
+        // operation costs a single extra clock read
+        timer::ticks t0 = 0, t1 = 0, t_now = 0, t_prev = 0;
+
+        // Latency of every operation
+        histogram lat;
+
+        for (size_t e = cf.min_len_log; e <= cf.max_len_log; e++) {
+            const size_t msg_len = 1UL << e;
+
+            size_t iter, warm_up;
+
+            if (msg_len < (1UL << 17)) {
+                pick_iters(cf, 10000, iter, warm_up);
+            } else {
+                pick_iters(cf, 500, iter, warm_up);
+            }
+
+            double put_time = 0.0;
+
+            lat.clear();
+
+            if (is_active(w, cf)) {
+                size_t offset = 0;
+
+                sync_active(m, w, cf);
+
+                for (size_t i = 0; i < iter + warm_up; i++) {
+                    if (i == warm_up) {
+                        t0 = timer::now();
+                        t_prev = t0;
+                    }
+
+                    shmem_ctx_putmem(w.ctx, rbuf + offset, sbuf + offset, msg_len, w.peer_pe);
+
+                    if (i >= warm_up) {
+                        t_now = timer::now();
+                        lat.record(uint64_t(timer::ns(t_now - t_prev)));
+                        t_prev = t_now;
+                    }
+
+                    offset += msg_len;
+                    if ((offset + msg_len) >= TH_SEG_LEN) {
+                        offset = 0;
+                    }
+                }
+
+                shmem_ctx_quiet(w.ctx);
+
+                t1 = timer::now();
+
+                put_time += timer::us(t1 - t0);
+
+                put_time /= double(iter);
+
+                publish_hist(m, w, lat);
+            }
+
+            m.publish(w, stats[0], put_time);
+
+            m.barrier();
+
+            // Do statistics
+            if (w.is_reporter) {
+                const summary s = summarize(stats[0], cf);
+
+                record r;
+                r.add("size", msg_len)
+                 .add("iters", iter)
+                 .add("min_us", s.min)
+                 .add("max_us", s.max)
+                 .add("avg_us", s.avg);
+                add_percentiles(r, merge_hists(cf));
+                r.add("time_us", active_slots(stats[0], cf));
+                reporter::emit(r);
+            }
+        }
+    });
+}
+
+
+template <typename M>
+void bench_get(M& m, uint8_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        auto sbuf = heap + w.tid * TH_SEG_LEN;
+        auto rbuf = heap + SR_BUF_LEN + w.tid * TH_SEG_LEN;
+
+        if (w.is_reporter) {
+            reporter::text() << "Benchmarking " << (cf.one_way ? "unidirectional" : "bidirectional")
+                             << " blocking get, time unit microseconds:\n";
+        }
+
+        // t_prev is the end of the previous operation, so timing every
+        // operation costs a single extra clock read
+        timer::ticks t0 = 0, t1 = 0, t_now = 0, t_prev = 0;
+
+        // Latency of every operation
+        histogram lat;
+
+        for (size_t e = cf.min_len_log; e <= cf.max_len_log; e++) {
+            const size_t msg_len = 1UL << e;
+
+            size_t iter, warm_up;
+
+            if (msg_len < (1UL << 17)) {
+                pick_iters(cf, 10000, iter, warm_up);
+            } else {
+                pick_iters(cf, 500, iter, warm_up);
+            }
+
+            double get_time = 0.0;
+
+            lat.clear();
+
+            if (is_active(w, cf)) {
+                size_t offset = 0;
+
+                sync_active(m, w, cf);
+
+                for (size_t i = 0; i < iter + warm_up; i++) {
+                    if (i == warm_up) {
+                        t0 = timer::now();
+                        t_prev = t0;
+                    }
+
+                    shmem_ctx_getmem(w.ctx, rbuf + offset, sbuf + offset, msg_len, w.peer_pe);
+
+                    if (i >= warm_up) {
+                        t_now = timer::now();
+                        lat.record(uint64_t(timer::ns(t_now - t_prev)));
+                        t_prev = t_now;
+                    }
+
+                    offset += msg_len;
+                    if ((offset + msg_len) >= TH_SEG_LEN) {
+                        offset = 0;
+                    }
+                }
+
+                shmem_ctx_quiet(w.ctx);
+
+                t1 = timer::now();
+
+                get_time += timer::us(t1 - t0);
+
+                get_time /= double(iter);
+
+                publish_hist(m, w, lat);
+            }
+
+            m.publish(w, stats[0], get_time);
+
+            m.barrier();
+
+            // Do statistics
+            if (w.is_reporter) {
+                const summary s = summarize(stats[0], cf);
+
+                record r;
+                r.add("size", msg_len)
+                 .add("iters", iter)
+                 .add("min_us", s.min)
+                 .add("max_us", s.max)
+                 .add("avg_us", s.avg);
+                add_percentiles(r, merge_hists(cf));
+                r.add("time_us", active_slots(stats[0], cf));
+                reporter::emit(r);
+            }
+        }
+    });
+}
+
+
+template <typename M>
+void bench_amo64_post(M& m, uint8_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        auto amo_target = ((uint64_t*)heap) + 1;
+
+        if (w.is_reporter) {
+            reporter::text() << "Benchmarking " << (cf.one_way ? "unidirectional" : "bidirectional")
+                             << " atomic post, time unit microseconds:\n";
+        }
+
+        timer::ticks t0 = 0, t1 = 0;
+
+        size_t iter, warm_up;
+        pick_iters(cf, 100000, iter, warm_up);
+
+        double time = 0.0;
+
+        if (is_active(w, cf)) {
+            sync_active(m, w, cf);
+
+            for (size_t i = 0; i < iter + warm_up; i++) {
+                if (i == warm_up) {
+                    shmem_ctx_quiet(w.ctx);
+
+                    sync_active(m, w, cf);
+
+                    t0 = timer::now();
+                }
+
+                shmem_ctx_uint64_atomic_add(w.ctx, amo_target, 1, w.amo_pe);
+            }
+
+            shmem_ctx_quiet(w.ctx);
+
+            t1 = timer::now();
+
+            time += timer::us(t1 - t0);
+
+            time /= double(iter);
+        } else {
+            // Prevent active polling from the waituntil in the barrier
+            sleep(5);
+        }
+
+        m.publish(w, stats[0], time);
+
+        m.barrier();
+
+        if (w.is_reporter) {
+            const summary s = summarize(stats[0], cf);
+
+            record r;
+            r.add("iters", iter)
+             .add("min_us", s.min)
+             .add("max_us", s.max)
+             .add("avg_us", s.avg)
+             .add("time_us", active_slots(stats[0], cf));
+            reporter::emit(r);
+        }
+    });
+}
+
+
+template <typename M>
+void bench_amo64_fetch(M& m, uint8_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        auto amo_target = ((uint64_t*)heap) + 1;
+
+        if (w.is_reporter) {
+            reporter::text() << "Benchmarking " << (cf.one_way ? "unidirectional" : "bidirectional")
+                             << " atomic fetch, time unit microseconds:\n";
+        }
+
+        // Every swap depends on the result of the previous one, so the
+        // compiler & the library can't overlap them
+        uint64_t amo_result = w.rank;
+
+        // t_prev is the end of the previous swap, so timing every swap
+        // costs a single extra clock read
+        timer::ticks t0 = 0, t1 = 0, t_now = 0, t_prev = 0;
+
+        // Latency of every swap
+        histogram lat;
+        lat.clear();
+
+        size_t iter, warm_up;
+        pick_iters(cf, 100000, iter, warm_up);
+
+        double time = 0.0;
+
+        if (is_active(w, cf)) {
+            sync_active(m, w, cf);
+
+            for (size_t i = 0; i < iter + warm_up; i++) {
+                if (i == warm_up) {
+                    t0 = timer::now();
+                    t_prev = t0;
+                }
+
+                amo_result = shmem_ctx_uint64_atomic_swap(w.ctx, amo_target, amo_result, w.amo_pe);
+
+                if (i >= warm_up) {
+                    t_now = timer::now();
+                    lat.record(uint64_t(timer::ns(t_now - t_prev)));
+                    t_prev = t_now;
+                }
+            }
+
+            t1 = timer::now();
+
+            time += timer::us(t1 - t0);
+
+            time /= double(iter);
+
+            publish_hist(m, w, lat);
+        }
+
+        m.publish(w, stats[0], time);
+
+        m.barrier();
+
+        // Do statistics
+        if (w.is_reporter) {
+            const summary s = summarize(stats[0], cf);
+
+            record r;
+            r.add("iters", iter)
+             .add("min_us", s.min)
+             .add("max_us", s.max)
+             .add("avg_us", s.avg);
+            add_percentiles(r, merge_hists(cf));
+            r.add("time_us", active_slots(stats[0], cf));
+            reporter::emit(r);
+        }
+    });
+}
+
+
+// Stream non-blocking puts (or gets) with up to W of them in flight, the window
+// is only drained with a quiet once it is full
+template <typename M, bool IS_PUT>
+void bench_stream(M& m, uint8_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        auto sbuf = heap + w.tid * TH_SEG_LEN;
+        auto rbuf = heap + SR_BUF_LEN + w.tid * TH_SEG_LEN;
+
+        if (w.is_reporter) {
+            reporter::text() << "Benchmarking " << (cf.one_way ? "unidirectional" : "bidirectional")
+                             << " streaming non-blocking " << (IS_PUT ? "put" : "get")
+                             << ", aggregate of all active workers:\n";
+        }
+
+        timer::ticks t0 = 0, t1 = 0;
+
+        for (size_t e = cf.min_len_log; e <= cf.max_len_log; e++) {
+            const size_t msg_len = 1UL << e;
+
+            for (size_t we = cf.min_window_log; we <= cf.max_window_log; we++) {
+                const size_t window = 1UL << we;
+
+                // Move about 256 MB but no more than 128K messages, and always
+                // fill the window at least once
+                size_t iter, warm_up;
+                pick_iters(cf, std::min(1UL << 17, (1UL << 28) >> e), iter, warm_up);
+
+                const size_t n_rounds  = std::max(1UL, (iter + window - 1) / window);
+                const size_t n_warm_up = (warm_up + window - 1) / window;
+
+                double msg_rate  = 0.0;
+                double byte_rate = 0.0;
+
+                if (is_active(w, cf)) {
+                    size_t offset = 0;
+
+                    sync_active(m, w, cf);
+
+                    for (size_t r = 0; r < n_rounds + n_warm_up; r++) {
+                        if (r == n_warm_up) {
+                            t0 = timer::now();
+                        }
+
+                        for (size_t i = 0; i < window; i++) {
+                            if (IS_PUT) {
+                                shmem_ctx_putmem_nbi(w.ctx, rbuf + offset, sbuf + offset, msg_len, w.peer_pe);
+                            } else {
+                                shmem_ctx_getmem_nbi(w.ctx, rbuf + offset, sbuf + offset, msg_len, w.peer_pe);
+                            }
+
+                            offset += msg_len;
+                            if ((offset + msg_len) > TH_SEG_LEN) {
+                                offset = 0;
+                            }
+                        }
+
+                        shmem_ctx_quiet(w.ctx);
+                    }
+
+                    t1 = timer::now();
+
+                    const double T = timer::s(t1 - t0);
+
+                    msg_rate  = n_rounds * window / T;
+                    byte_rate = msg_rate * msg_len;
+                }
+
+                m.publish(w, stats[0], msg_rate);
+                m.publish(w, stats[1], byte_rate);
+
+                m.barrier();
+
+                if (w.is_reporter) {
+                    record r;
+                    r.add("size", msg_len)
+                     .add("window", window)
+                     .add("gb_per_s", summarize(stats[1], cf).sum / 1e9)
+                     .add("mmsgs_per_s", summarize(stats[0], cf).sum / 1e6)
+                     .add("msgs_per_s", active_slots(stats[0], cf));
+                    reporter::emit(r);
+                }
+            }
+        }
+    });
+}
+
+
+// The destination nodes of a node, the same on all the PEs
+std::vector<size_t> dest_nodes(const pattern pt, const size_t node, const size_t n_nodes)
+{
+    std::vector<size_t> dests;
+
+    switch (pt) {
+        case pattern::Pairwise:
+            if (partner_node(node, n_nodes) != node) {
+                dests.push_back(partner_node(node, n_nodes));
+            }
+            break;
+        case pattern::Ring:
+            dests.push_back((node + 1) % n_nodes);
+            break;
+        case pattern::Random:
+            {
+                // Every PE draws the same permutation, until no node would
+                // talk to itself
+                std::mt19937 rng(1234);
+                std::vector<size_t> perm(n_nodes);
+                bool fixed_point;
+
+                do {
+                    for (size_t i = 0; i < n_nodes; i++) {
+                        perm[i] = i;
+                    }
+
+                    std::shuffle(perm.begin(), perm.end(), rng);
+
+                    fixed_point = false;
+                    for (size_t i = 0; i < n_nodes; i++) {
+                        if (perm[i] == i) {
+                            fixed_point = true;
+                        }
+                    }
+                } while (fixed_point);
+
+                dests.push_back(perm[node]);
+                break;
+            }
+        case pattern::AllToAll:
+            for (size_t i = 1; i < n_nodes; i++) {
+                dests.push_back((node + i) % n_nodes);
+            }
+            break;
+    }
+
+    return dests;
+}
+
+
+// Message rate and bandwidth of non-blocking puts between the workers with the
+// same rank on all the nodes, the destinations follow --pattern and the window
+// is the largest one of --window
+template <typename M>
+void bench_pattern(M& m, uint8_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        auto sbuf = heap + w.tid * TH_SEG_LEN;
+        auto rbuf = heap + SR_BUF_LEN + w.tid * TH_SEG_LEN;
+
+        const size_t window = 1UL << cf.max_window_log;
+
+        std::vector<size_t> dest_pes;
+        for (const size_t node : dest_nodes(cf.pt, w.node, N_NODES)) {
+            dest_pes.push_back(m.pe_of(node, w.rank));
+        }
+
+        const char* pattern_name = "";
+        for (const auto& p : PATTERNS) {
+            if (p.pt == cf.pt) {
+                pattern_name = p.name;
+            }
+        }
+
+        if (w.is_reporter) {
+            reporter::text() << "Benchmarking " << pattern_name << " non-blocking put among "
+                             << N_NODES << " nodes, window " << window << ", per node:\n";
+        }
+
+        timer::ticks t0 = 0, t1 = 0;
+
+        for (size_t e = cf.min_len_log; e <= cf.max_len_log; e++) {
+            const size_t msg_len = 1UL << e;
+
+            size_t iter, warm_up;
+            pick_iters(cf, std::min(1UL << 17, (1UL << 28) >> e), iter, warm_up);
+
+            const size_t n_rounds  = std::max(1UL, (iter + window - 1) / window);
+            const size_t n_warm_up = (warm_up + window - 1) / window;
+
+            double msg_rate = 0.0;
+
+            m.barrier();
+
+            if (!dest_pes.empty()) {
+                size_t offset = 0;
+                size_t next   = 0;
+
+                for (size_t r = 0; r < n_rounds + n_warm_up; r++) {
+                    if (r == n_warm_up) {
+                        t0 = timer::now();
+                    }
+
+                    // Go around the destinations one message at a time
+                    for (size_t i = 0; i < window; i++) {
+                        shmem_ctx_putmem_nbi(w.ctx, rbuf + offset, sbuf + offset, msg_len, dest_pes[next]);
+
+                        next = (next + 1 == dest_pes.size()) ? 0 : next + 1;
+
+                        offset += msg_len;
+                        if ((offset + msg_len) > TH_SEG_LEN) {
+                            offset = 0;
+                        }
+                    }
+
+                    shmem_ctx_quiet(w.ctx);
+                }
+
+                t1 = timer::now();
+
+                msg_rate = n_rounds * window / timer::s(t1 - t0);
+            }
+
+            m.publish(w, stats[0], msg_rate);
+
+            m.barrier();
+
+            // Sum up the workers of every node, the idle nodes don't count
+            if (w.is_reporter) {
+                double tot_rate = 0.0;
+                double min_rate = 0.0;
+                double max_rate = 0.0;
+                size_t n_active = 0;
+
+                for (size_t node = 0; node < N_NODES; node++) {
+                    if (dest_nodes(cf.pt, node, N_NODES).empty()) {
+                        continue;
+                    }
+
+                    double node_rate = 0.0;
+                    for (size_t i = 0; i < N_WORKERS; i++) {
+                        node_rate += stats[0][node * N_WORKERS + i];
+                    }
+
+                    if ((n_active == 0) || (node_rate < min_rate)) {
+                        min_rate = node_rate;
+                    }
+
+                    if ((n_active == 0) || (node_rate > max_rate)) {
+                        max_rate = node_rate;
+                    }
+
+                    tot_rate += node_rate;
+                    n_active++;
+                }
+
+                const double avg_rate = tot_rate / n_active;
+
+                std::vector<double> rates(stats[0], stats[0] + N_NODES * N_WORKERS);
+
+                record r;
+                r.add("pattern", pattern_name)
+                 .add("size", msg_len)
+                 .add("window", window)
+                 .add("avg_mmsgs_per_s", avg_rate / 1e6)
+                 .add("avg_gb_per_s", avg_rate * msg_len / 1e9)
+                 .add("min_gb_per_s", min_rate * msg_len / 1e9)
+                 .add("max_gb_per_s", max_rate * msg_len / 1e9)
+                 .add("total_gb_per_s", tot_rate * msg_len / 1e9)
+                 .add("msgs_per_s", rates);
+                reporter::emit(r);
+            }
+        }
+    });
+}
+
+
+template <typename M>
+using bench_fn = void (*)(M&, uint8_t*, const config&);
+
+// All the benchmarks that can be selected with --bench, in the order they are
+// executed when more than one of them is selected
+template <typename M>
+struct bench_entry {
+    const char* name;
+    bench_fn<M> fn;
+    const char* desc;
+    // Whether it runs on any number of nodes instead of exactly two
+    bool multi_node;
+};
+
+template <typename M>
+std::vector<bench_entry<M>> benches()
+{
+    return {
+        {"put_nbi",   bench_put_nbi<M>,       "non-blocking put, post & flush time per message",   false},
+        {"get_nbi",   bench_get_nbi<M>,       "non-blocking get, post & flush time per message",   false},
+        {"put",       bench_put<M>,           "blocking put message rate",                         false},
+        {"get",       bench_get<M>,           "blocking get message rate",                         false},
+        {"amo_post",  bench_amo64_post<M>,    "64-bit atomic add message rate",                    false},
+        {"amo_fetch", bench_amo64_fetch<M>,   "64-bit atomic swap latency",                        false},
+        {"put_bw",    bench_stream<M, true>,  "streaming non-blocking put bandwidth vs. window",   false},
+        {"get_bw",    bench_stream<M, false>, "streaming non-blocking get bandwidth vs. window",   false},
+        {"pattern",   bench_pattern<M>,       "put rate & bandwidth among N nodes, see --pattern", true},
+    };
+}
+
+
+// Run the stress test and the selected benchmarks with the execution model M
+template <typename M>
+void run_benches(const config& cf, const size_t n_workers)
+{
+    int tl_supported;
+
+    shmem_init_thread(M::thread_level(n_workers), &tl_supported);
+
+    if (tl_supported < M::thread_level(n_workers)) {
+        if (shmem_my_pe() == 0) {
+            std::cout << "Error: Could not enable the desired thread level!\n";
+        }
+        shmem_global_exit(1);
+    }
+
+    M m(n_workers);
+
+    if ((n_workers > N_WORKERS_MAX) || !m.valid() ||
+        (m.n_nodes() < 2) || (m.n_nodes() > N_NODES_MAX)) {
+        if (shmem_my_pe() == 0) {
+            std::cout << "Error: the " << M::name() << " model needs 2 to " << N_NODES_MAX
+                      << " nodes of " << n_workers << " workers each, and at most "
+                      << N_WORKERS_MAX << " workers per node\n";
+        }
+        shmem_global_exit(1);
+    }
+
+    // Only some benchmarks can use more than two nodes
+    if (m.n_nodes() != 2) {
+        bool ok = cf.skip_stress;
+
+        for (const auto& b : benches<M>()) {
+            for (const auto& name : cf.benches) {
+                if ((name == b.name) && !b.multi_node) {
+                    ok = false;
+                }
+            }
+        }
+
+        if (!ok) {
+            if (shmem_my_pe() == 0) {
+                std::cout << "Error: only the pattern benchmark runs on " << m.n_nodes()
+                          << " nodes, the others and the stress test need exactly 2\n";
+            }
+            shmem_global_exit(1);
+        }
+    }
+
+    N_NODES      = m.n_nodes();
+    N_WORKERS    = m.workers_per_node();
+    N_WORKERS_PE = m.workers_per_pe();
+    SR_BUF_LEN   = N_WORKERS_PE * TH_SEG_LEN;
+    HEAP_LEN     = 2 * SR_BUF_LEN;
+
+    reporter::set("model", M::name());
+    reporter::set("nodes", N_NODES);
+    reporter::set("workers_per_node", N_WORKERS);
+    reporter::set("workers_per_pe", N_WORKERS_PE);
+    reporter::set("one_way", cf.one_way);
+    reporter::set("timer", timer::source());
+
+    if (shmem_my_pe() == 0) {
+        reporter::text() << "Running with the " << M::name() << " model, " << N_NODES << " nodes, "
+                         << N_WORKERS << " worker(s) per node, timer " << timer::source();
+        if (timer::tsc_ghz() > 0.0) {
+            reporter::text() << " (" << std::setprecision(4) << timer::tsc_ghz() << " GHz)";
+        }
+        reporter::text() << '\n';
+    }
+
+    const size_t page_size  = sysconf(_SC_PAGESIZE);
+    auto heap = (uint8_t*)shmem_align(page_size, HEAP_LEN * sizeof(uint8_t));
+
+    if (!cf.skip_stress) {
+        reporter::set("bench", "stress");
+        stress_test(m, heap, cf);
+    }
+
+    // Benchmarks run in the order of the registry, no matter how they were
+    // listed on the command line
+    for (const auto& b : benches<M>()) {
+        for (const auto& name : cf.benches) {
+            if (name == b.name) {
+                shmem_barrier_all();
+                reporter::set("bench", b.name);
+                b.fn(m, heap, cf);
+                break;
+            }
+        }
+    }
+
+    shmem_barrier_all();
+
+    shmem_free(heap);
+
+    shmem_finalize();
+}
+
+
+void print_help(const config& cf)
+{
+    std::cout << "Usage: microbenchmarks [options] [n_workers]\n"
+              << "Options:\n"
+              << "    -h, --help             Prints this help message\n"
+              << "    -l, --list             Lists the available benchmarks\n"
+              << "    -m, --model <model>    Execution model (default: " << cf.model << ")\n"
+              << "                               pure:       one PE per worker\n"
+              << "                               threads:    threads share the default context\n"
+              << "                               ctx:        one private context per thread\n"
+              << "                               shared_ctx: threads share one context per PE\n"
+              << "    -t, --workers <n>      Number of workers (threads or PEs) per node (default: 1)\n"
+              << "    -b, --bench <b1,b2,..> Benchmarks to run, or \"all\" (default: none)\n"
+              << "    -s, --sizes <min:max>  Range of message sizes in bytes, K/M suffixes are\n"
+              << "                           accepted and sizes are rounded to powers of two\n"
+              << "                           (default: 1:" << (1UL << cf.max_len_log) << ")\n"
+              << "    -W, --window <min:max> Range of outstanding operations of the streaming\n"
+              << "                           benchmarks, rounded to powers of two\n"
+              << "                           (default: 1:" << (1UL << cf.max_window_log) << ")\n"
+              << "    -P, --pattern <name>   Destinations of the pattern benchmark (default: pairwise)\n"
+              << "                               pairwise, ring, random or alltoall\n"
+              << "    -i, --iters <n>        Number of timed iterations (default: per benchmark)\n"
+              << "    -w, --warmup <n>       Number of warm-up iterations (default: iters / 10)\n"
+              << "    -d, --bidir            Both nodes communicate at the same time (default: disabled)\n"
+              << "    -S, --skip-stress      Do not run the stress test (default: disabled)\n"
+              << "    -f, --format <fmt>     Output format, table, json or csv (default: table)\n";
+}
+
+
+void print_benches()
+{
+    for (const auto& b : benches<pure_model>()) {
+        std::cout << std::setw(12) << std::left << b.name << b.desc << '\n';
+    }
+}
+
+
+// Parse a message size with an optional K/M/G suffix, returns 0 on error
+size_t parse_size(const std::string& str)
+{
+    char* end;
+    size_t sz = std::strtoul(str.c_str(), &end, 10);
+
+    switch (*end) {
+        case 'k': case 'K':
+            sz <<= 10;
+            end++;
+            break;
+        case 'm': case 'M':
+            sz <<= 20;
+            end++;
+            break;
+        case 'g': case 'G':
+            sz <<= 30;
+            end++;
+            break;
+        default:
+            break;
+    }
+
+    return (*end == '\0') ? sz : 0;
+}
+
+
+// Parse a range "min:max" (or a single value) with values in [1, max_val] and
+// round it to powers of two, returns true on error
+bool parse_log_range(const std::string& range, const size_t max_val, size_t& min_log, size_t& max_log)
+{
+    const size_t sep = range.find(':');
+    const size_t min_len = parse_size(range.substr(0, sep));
+    const size_t max_len = (sep == std::string::npos) ? min_len : parse_size(range.substr(sep + 1));
+
+    if ((min_len == 0) || (max_len < min_len) || (max_len > max_val)) {
+        std::cout << "Error: bad range " << range
+                  << ", values must be within [1, " << max_val << "]\n";
+        return true;
+    }
+
+    // Round the lower bound up and the upper bound down
+    min_log = 0;
+    while ((1UL << min_log) < min_len) {
+        min_log++;
+    }
+
+    max_log = 0;
+    while ((2UL << max_log) <= max_len) {
+        max_log++;
+    }
+
+    if (min_log > max_log) {
+        std::cout << "Error: no power of two in the range " << range << '\n';
+        return true;
+    }
+
+    return false;
+}
+
+
+// Parse commandline arguments
+// Returns true if something goes wrong or there is nothing to run
+bool parse_args(const int argc, char** argv, config& cf, size_t& n_workers)
+{
+    const option long_opts[] = {
+        {"help",        no_argument,       nullptr, 'h'},
+        {"list",        no_argument,       nullptr, 'l'},
+        {"model",       required_argument, nullptr, 'm'},
+        {"workers",     required_argument, nullptr, 't'},
+        {"bench",       required_argument, nullptr, 'b'},
+        {"sizes",       required_argument, nullptr, 's'},
+        {"iters",       required_argument, nullptr, 'i'},
+        {"warmup",      required_argument, nullptr, 'w'},
+        {"bidir",       no_argument,       nullptr, 'd'},
+        {"skip-stress", no_argument,       nullptr, 'S'},
+        {"window",      required_argument, nullptr, 'W'},
+        {"pattern",     required_argument, nullptr, 'P'},
+        {"format",      required_argument, nullptr, 'f'},
+        {nullptr,       0,                 nullptr, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hlm:t:b:s:W:P:i:w:dSf:", long_opts, nullptr)) != -1) {
+        switch (c) {
+            case 'h':
+                print_help(cf);
+                return true;
+            case 'l':
+                print_benches();
+                return true;
+            case 'm':
+                cf.model = optarg;
+                break;
+            case 't':
+                n_workers = std::atoi(optarg);
+                break;
+            case 'b':
+                {
+                    std::string list(optarg);
+                    size_t pos = 0;
+                    while (pos <= list.size()) {
+                        size_t next = list.find(',', pos);
+                        if (next == std::string::npos) {
+                            next = list.size();
+                        }
+                        cf.benches.push_back(list.substr(pos, next - pos));
+                        pos = next + 1;
+                    }
+                    break;
+                }
+            case 's':
+                if (parse_log_range(optarg, TH_SEG_LEN, cf.min_len_log, cf.max_len_log)) {
+                    return true;
+                }
+                break;
+            case 'W':
+                if (parse_log_range(optarg, 1UL << MAX_WINDOW_LOG, cf.min_window_log, cf.max_window_log)) {
+                    return true;
+                }
+                break;
+            case 'P':
+                {
+                    bool found = false;
+                    for (const auto& p : PATTERNS) {
+                        if (std::strcmp(optarg, p.name) == 0) {
+                            cf.pt = p.pt;
+                            found = true;
+                        }
+                    }
+
+                    if (!found) {
+                        std::cout << "Error: unknown pattern \"" << optarg << "\"\n";
+                        return true;
+                    }
+                    break;
+                }
+            case 'f':
+                if (!reporter::parse_format(optarg, cf.fmt)) {
+                    std::cout << "Error: unknown output format \"" << optarg << "\"\n";
+                    return true;
+                }
+                break;
+            case 'i':
+                cf.iters = std::atol(optarg);
+                break;
+            case 'w':
+                cf.warm_up = std::atol(optarg);
+                break;
+            case 'd':
+                cf.one_way = false;
+                break;
+            case 'S':
+                cf.skip_stress = true;
+                break;
+            default:
+                print_help(cf);
+                return true;
+        }
+    }
+
+    // Keep accepting the number of workers as the only positional argument
+    if (optind < argc) {
+        n_workers = std::atoi(argv[optind]);
+    }
+
+    if (n_workers == 0) {
+        std::cout << "Error: need at least one worker per node\n";
+        return true;
+    }
+
+    // Expand "all" and reject the names we don't know before doing anything
+    std::vector<std::string> selected;
+    for (const auto& name : cf.benches) {
+        bool found = false;
+        for (const auto& b : benches<pure_model>()) {
+            if ((name == "all") || (name == b.name)) {
+                selected.push_back(b.name);
+                found = true;
+            }
+        }
+
+        if (!found) {
+            std::cout << "Error: unknown benchmark \"" << name << "\", available ones are:\n";
+            print_benches();
+            return true;
+        }
+    }
+    cf.benches = selected;
+
+    return false;
+}
+
+
+int main(int argc, char** argv)
+{
+    config cf;
+
+    cf.min_len_log    = 0;
+    cf.max_len_log    = TH_SEG_LEN_LOG;
+    cf.min_window_log = 0;
+    cf.max_window_log = MAX_WINDOW_LOG;
+    cf.iters          = 0;
+    cf.warm_up        = -1;
+    cf.one_way        = true;
+    cf.skip_stress    = false;
+    cf.pt             = pattern::Pairwise;
+    cf.fmt            = reporter::format::Table;
+    cf.model          = "threads";
+
+    size_t n_workers = 1;
+
+    // Exit in case anything goes wrong
+    if (parse_args(argc, argv, cf, n_workers)) {
+        return 1;
+    }
+
+    timer::init();
+    reporter::init("microbenchmarks", cf.fmt);
+
+    if (cf.model == "pure") {
+        run_benches<pure_model>(cf, n_workers);
+    } else if (cf.model == "threads") {
+        run_benches<thread_model<ctx_kind::Default>>(cf, n_workers);
+    } else if (cf.model == "ctx") {
+        run_benches<thread_model<ctx_kind::Private>>(cf, n_workers);
+    } else if (cf.model == "shared_ctx") {
+        run_benches<thread_model<ctx_kind::Shared>>(cf, n_workers);
+    } else {
+        std::cout << "Error: unknown execution model \"" << cf.model << "\"\n";
+        print_help(cf);
+        return 1;
+    }
+}
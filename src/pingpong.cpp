@@ -0,0 +1,612 @@
+// Ping-pong between the workers with the same rank on two nodes
+//
+// The two workers of a pair hit a ball back and forth. The last word of every
+// message carries the ball, which is the number of times it has been hit, and
+// the rest of the message is payload. The transport decides how the ball gets
+// to the other side:
+//   put:   one putmem of the whole message, the receiver spins on its last word
+//          (relies on the last word landing last, like the fabrics we use do)
+//   fadd:  putmem of the payload, fence, then fetch-add on the ball
+//   add:   putmem of the payload, fence, then non-fetching add on the ball
+//   fence: putmem of the payload, fence, then a 4-byte put of the ball
+//   signal: a single put-with-signal, only if the library has OpenSHMEM 1.5
+// With 4-byte messages there is no payload, so fadd and add are the classic AMO
+// ping-pong.
+//
+// The execution model (see exec_model.hpp) is selected at run time with --model,
+// and the way the receiver waits for the ball (see wait.hpp) with --wait.
+
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <unistd.h>
+#include <shmem.h>
+#include <omp.h>
+
+#include "exec_model.hpp"
+#include "reporter.hpp"
+#include "timer.hpp"
+#include "wait.hpp"
+
+
+// Length of the segment of every worker, in 4-byte words
+#define TH_SEG_LEN_LOG 21
+#define TH_SEG_LEN (1UL << TH_SEG_LEN_LOG)
+
+#define N_WORKERS_MAX 64
+
+size_t N_WORKERS, SR_BUF_LEN, HEAP_LEN;
+
+// Time and CPU usage of every worker, collected on the reporter PE
+double worker_times[2 * N_WORKERS_MAX];
+double worker_cpu[2 * N_WORKERS_MAX];
+
+#ifdef SHMEM_SIGNAL_SET
+// Signal words of the put-with-signal transport, one cache line per thread
+uint64_t signals[N_WORKERS_MAX * 8];
+#endif
+
+
+enum class transport {
+    Put,
+    FetchAdd,
+    Add,
+    FencedFlag,
+    Signal
+};
+
+
+struct transport_entry {
+    const char* name;
+    transport tr;
+    const char* desc;
+};
+
+const transport_entry TRANSPORTS[] = {
+    {"put",    transport::Put,        "putmem of the whole message, spin on its last word"},
+    {"fadd",   transport::FetchAdd,   "payload putmem + fence + fetch-add on the last word"},
+    {"add",    transport::Add,        "payload putmem + fence + add on the last word"},
+    {"fence",  transport::FencedFlag, "payload putmem + fence + put of the last word"},
+#ifdef SHMEM_SIGNAL_SET
+    {"signal", transport::Signal,     "putmem_signal of the payload, spin on the signal"},
+#endif
+};
+
+
+struct config {
+    std::string model;
+    transport tr;
+    wait_kind wait;
+    // Message sizes in bytes, multiples of 4
+    std::vector<size_t> sizes;
+    // Zero means scaling the iterations with the message size
+    size_t iters;
+    // Negative means using 1/8 of the iterations
+    long warm_up;
+    reporter::format fmt;
+};
+
+
+// Pick the number of timed and warm-up iterations of a message size
+void pick_iters(const config& cf, const size_t msg_bytes, size_t& iter, size_t& warm_up)
+{
+    if (cf.iters != 0) {
+        iter = cf.iters;
+    } else if (msg_bytes < (1UL << 17)) {
+        iter = 1UL << 16;
+    } else {
+        iter = 1UL << 10;
+    }
+
+    if (cf.warm_up < 0) {
+        warm_up = iter / 8;
+    } else {
+        warm_up = cf.warm_up;
+    }
+}
+
+
+// Hit the ball back to the peer of w, msg_len is in words and includes the ball
+void send_ball(const config& cf, const worker& w, uint32_t* rbuf, uint32_t* sbuf,
+               const size_t msg_len, const uint32_t ball)
+{
+    const size_t payload = (msg_len - 1) * sizeof(uint32_t);
+    const auto rbuf_end  = rbuf + msg_len - 1;
+
+    switch (cf.tr) {
+        case transport::Put:
+            sbuf[msg_len - 1] = ball;
+            shmem_ctx_putmem(w.ctx, rbuf, sbuf, msg_len * sizeof(uint32_t), w.peer_pe);
+            break;
+        case transport::FetchAdd:
+            if (payload != 0) {
+                shmem_ctx_putmem(w.ctx, rbuf, sbuf, payload, w.peer_pe);
+                shmem_ctx_fence(w.ctx);
+            }
+            shmem_ctx_uint32_atomic_fetch_add(w.ctx, rbuf_end, 2, w.peer_pe);
+            break;
+        case transport::Add:
+            if (payload != 0) {
+                shmem_ctx_putmem(w.ctx, rbuf, sbuf, payload, w.peer_pe);
+                shmem_ctx_fence(w.ctx);
+            }
+            shmem_ctx_uint32_atomic_add(w.ctx, rbuf_end, 2, w.peer_pe);
+            break;
+        case transport::FencedFlag:
+            if (payload != 0) {
+                shmem_ctx_putmem(w.ctx, rbuf, sbuf, payload, w.peer_pe);
+                shmem_ctx_fence(w.ctx);
+            }
+            shmem_ctx_uint32_p(w.ctx, rbuf_end, ball, w.peer_pe);
+            break;
+        case transport::Signal:
+#ifdef SHMEM_SIGNAL_SET
+            shmem_ctx_putmem_signal(w.ctx, rbuf, sbuf, payload, &signals[w.tid * 8], ball,
+                                    SHMEM_SIGNAL_SET, w.peer_pe);
+#endif
+            break;
+    }
+}
+
+
+template <typename M>
+void pingpong(M& m, uint32_t* heap, const config& cf)
+{
+    m.run([&](worker& w) {
+        // Unique segments of the heap for all the workers
+        auto sbuf = heap + w.tid * TH_SEG_LEN;
+        auto rbuf = heap + SR_BUF_LEN + w.tid * TH_SEG_LEN;
+
+        if (w.is_reporter) {
+            reporter::text() << "Benchmarking ping-pong, time unit microseconds:\n";
+        }
+
+        timer::ticks t0 = 0, t1 = 0;
+
+        // CPU time of this thread, to see how much of the core the wait
+        // strategy leaves to others
+        timespec c0, c1;
+
+        for (const size_t msg_bytes : cf.sizes) {
+            const size_t msg_len = msg_bytes / sizeof(uint32_t);
+
+            size_t iter, warm_up;
+            pick_iters(cf, msg_bytes, iter, warm_up);
+
+            // Find an unique and easily identifiable base number to begin the game
+            // The most significant digits is the rank of the worker, and the rest
+            // stores the number of times the ball has been hit
+            const size_t magnitude = std::log10(2 * (iter + warm_up)) + 1;
+            const uint32_t base    = w.rank * std::pow(size_t(10), magnitude);
+
+            // Fill the buffers with garbage
+            for (size_t i = 0; i < TH_SEG_LEN; i++) {
+                sbuf[i] = 0xFFFFFFFF;
+                rbuf[i] = 0xFFFFFFFF;
+            }
+
+            // The ball on its way back to me, updated by the other side
+            uint32_t* rbuf_end = rbuf + msg_len - 1;
+
+            #ifdef SHMEM_SIGNAL_SET
+            uint64_t* signal = &signals[w.tid * 8];
+            #endif
+
+            // # of times the ball has been hit the last time it left me
+            uint32_t ball;
+
+            // Proper initialization of the players' statuses, the adds of the
+            // AMO transports move the ball from one hit to the next one
+            if (w.node == 0) {
+                ball      = base;           // Node 0 hasn't hit the ball yet
+                *rbuf_end = base + 1;       // The judge throws the ball to node 0
+            } else {
+                ball      = base + 1;       // Expecting the ball from node 0
+                *rbuf_end = base;           // To be updated by node 0
+            }
+
+            #ifdef SHMEM_SIGNAL_SET
+            *signal = *rbuf_end;
+            #endif
+
+            m.barrier();
+
+            // Let the games begin!
+            for (size_t i = 0; i < iter + warm_up; i++) {
+                if (i == warm_up) {
+                    m.barrier();
+
+                    t0 = timer::now();
+                    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+                }
+
+                // Wait for the ball, it has been hit one more time since the
+                // last time it left me
+                if (cf.tr == transport::Signal) {
+                    #ifdef SHMEM_SIGNAL_SET
+                    wait_for(cf.wait, signal, uint64_t(ball + 1));
+                    #endif
+                } else {
+                    wait_for(cf.wait, rbuf_end, uint32_t(ball + 1));
+                }
+
+                // Send the ball back
+                ball += 2;
+
+                send_ball(cf, w, rbuf, sbuf, msg_len, ball);
+            }
+
+            t1 = timer::now();
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+
+            const double wall_time = timer::us(t1 - t0);
+            const double cpu_time  = (c1.tv_sec - c0.tv_sec) * 1000000.0
+                                   + (c1.tv_nsec - c0.tv_nsec) / 1000.0;
+
+            m.publish(w, worker_times, wall_time);
+            m.publish(w, worker_cpu, 100.0 * cpu_time / wall_time);
+
+            // The last ball of node 1 is never waited for, make sure it has
+            // landed before the buffers are refilled for the next size
+            shmem_ctx_quiet(w.ctx);
+
+            m.barrier();
+
+            // Do statistics over the workers of node 1, both sides of a pair
+            // take the same time
+            if (w.is_reporter) {
+                double min_time = worker_times[N_WORKERS];
+                double max_time = worker_times[N_WORKERS];
+                double tot_time = 0.0;
+                double tot_cpu  = 0.0;
+
+                for (size_t i = N_WORKERS; i < 2 * N_WORKERS; i++) {
+                    if (worker_times[i] < min_time) {
+                        min_time = worker_times[i];
+                    }
+
+                    if (worker_times[i] > max_time) {
+                        max_time = worker_times[i];
+                    }
+
+                    tot_time += worker_times[i];
+                    tot_cpu  += worker_cpu[i];
+                }
+
+                const double avg_time = tot_time / N_WORKERS;
+
+                // An iteration is a full round trip
+                const double half_rtt = avg_time / iter / 2;
+
+                record r;
+                r.add("size", msg_bytes)
+                 .add("iters", iter)
+                 .add("iter_min_us", min_time / iter)
+                 .add("iter_max_us", max_time / iter)
+                 .add("iter_avg_us", avg_time / iter)
+                 .add("half_rtt_us", half_rtt)
+                 .add("mb_per_s", msg_bytes / half_rtt)
+                 .add("cpu_pct", tot_cpu / N_WORKERS)
+                 .add("time_us", std::vector<double>(worker_times + N_WORKERS, worker_times + 2 * N_WORKERS))
+                 .add("cpu_pcts", std::vector<double>(worker_cpu + N_WORKERS, worker_cpu + 2 * N_WORKERS));
+                reporter::emit(r);
+            }
+        }
+    });
+}
+
+
+template <typename M>
+void run_pingpong(const config& cf, const size_t n_workers)
+{
+    int tl_supported;
+
+    shmem_init_thread(M::thread_level(n_workers), &tl_supported);
+
+    if (tl_supported < M::thread_level(n_workers)) {
+        if (shmem_my_pe() == 0) {
+            std::cout << "Error: Could not enable the desired thread level!\n";
+        }
+        shmem_global_exit(1);
+    }
+
+    M m(n_workers);
+
+    if ((n_workers > N_WORKERS_MAX) || !m.valid() || (m.n_nodes() != 2)) {
+        if (shmem_my_pe() == 0) {
+            std::cout << "Error: the " << M::name() << " model needs 2 nodes of " << n_workers
+                      << " workers each, and at most " << N_WORKERS_MAX << " workers per node\n";
+        }
+        shmem_global_exit(1);
+    }
+
+    N_WORKERS  = m.workers_per_node();
+    SR_BUF_LEN = m.workers_per_pe() * TH_SEG_LEN;
+    HEAP_LEN   = 2 * SR_BUF_LEN;
+
+    reporter::set("model", M::name());
+    reporter::set("workers_per_node", N_WORKERS);
+    reporter::set("workers_per_pe", m.workers_per_pe());
+
+    for (const auto& t : TRANSPORTS) {
+        if (t.tr == cf.tr) {
+            reporter::set("transport", t.name);
+        }
+    }
+
+    for (const auto& wt : WAITS) {
+        if (wt.kind == cf.wait) {
+            reporter::set("wait", wt.name);
+        }
+    }
+
+    reporter::set("timer", timer::source());
+
+    if (shmem_my_pe() == 0) {
+        reporter::text() << "Running with the " << M::name() << " model, "
+                         << N_WORKERS << " worker(s) per node";
+
+        for (const auto& t : TRANSPORTS) {
+            if (t.tr == cf.tr) {
+                reporter::text() << ", transport " << t.name;
+            }
+        }
+
+        for (const auto& wt : WAITS) {
+            if (wt.kind == cf.wait) {
+                reporter::text() << ", wait " << wt.name;
+            }
+        }
+
+        reporter::text() << ", timer " << timer::source() << '\n';
+    }
+
+    const size_t page_size  = sysconf(_SC_PAGESIZE);
+    auto heap = (uint32_t*)shmem_align(page_size, HEAP_LEN * sizeof(uint32_t));
+
+    pingpong(m, heap, cf);
+
+    shmem_barrier_all();
+
+    shmem_free(heap);
+
+    shmem_finalize();
+}
+
+
+void print_help(const config& cf)
+{
+    std::cout << "Usage: pingpong [options] [n_workers]\n"
+              << "Options:\n"
+              << "    -h, --help              Prints this help message\n"
+              << "    -l, --list              Lists the available transports and wait strategies\n"
+              << "    -m, --model <model>     Execution model (default: " << cf.model << ")\n"
+              << "                                pure:       one PE per worker\n"
+              << "                                threads:    threads share the default context\n"
+              << "                                ctx:        one private context per thread\n"
+              << "                                shared_ctx: threads share one context per PE\n"
+              << "    -t, --workers <n>       Number of workers (threads or PEs) per node (default: 1)\n"
+              << "    -x, --transport <name>  How the ball is sent (default: put)\n"
+              << "    -W, --wait <name>       How the ball is waited for (default: spin)\n"
+              << "    -s, --sizes <min:max>   Range of message sizes in bytes, K/M suffixes are\n"
+              << "                            accepted and sizes are rounded to powers of two\n"
+              << "                            (default: 4:" << TH_SEG_LEN * sizeof(uint32_t) << ")\n"
+              << "    -i, --iters <n>         Number of timed iterations (default: per size)\n"
+              << "    -w, --warmup <n>        Number of warm-up iterations (default: iters / 8)\n"
+              << "    -f, --format <fmt>      Output format, table, json or csv (default: table)\n";
+}
+
+
+void print_transports()
+{
+    std::cout << "Transports:\n";
+    for (const auto& t : TRANSPORTS) {
+        std::cout << "    " << std::setw(12) << std::left << t.name << t.desc << '\n';
+    }
+
+    std::cout << "Wait strategies:\n";
+    for (const auto& wt : WAITS) {
+        std::cout << "    " << std::setw(12) << std::left << wt.name << wt.desc << '\n';
+    }
+}
+
+
+// Parse a message size with an optional K/M/G suffix, returns 0 on error
+size_t parse_size(const std::string& str)
+{
+    char* end;
+    size_t sz = std::strtoul(str.c_str(), &end, 10);
+
+    switch (*end) {
+        case 'k': case 'K':
+            sz <<= 10;
+            end++;
+            break;
+        case 'm': case 'M':
+            sz <<= 20;
+            end++;
+            break;
+        case 'g': case 'G':
+            sz <<= 30;
+            end++;
+            break;
+        default:
+            break;
+    }
+
+    return (*end == '\0') ? sz : 0;
+}
+
+
+// Parse commandline arguments
+// Returns true if something goes wrong or there is nothing to run
+bool parse_args(const int argc, char** argv, config& cf, size_t& n_workers)
+{
+    const option long_opts[] = {
+        {"help",      no_argument,       nullptr, 'h'},
+        {"list",      no_argument,       nullptr, 'l'},
+        {"model",     required_argument, nullptr, 'm'},
+        {"workers",   required_argument, nullptr, 't'},
+        {"transport", required_argument, nullptr, 'x'},
+        {"wait",      required_argument, nullptr, 'W'},
+        {"sizes",     required_argument, nullptr, 's'},
+        {"iters",     required_argument, nullptr, 'i'},
+        {"warmup",    required_argument, nullptr, 'w'},
+        {"format",    required_argument, nullptr, 'f'},
+        {nullptr,     0,                 nullptr, 0}
+    };
+
+    const size_t max_bytes = TH_SEG_LEN * sizeof(uint32_t);
+
+    size_t min_len = sizeof(uint32_t);
+    size_t max_len = max_bytes;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hlm:t:x:W:s:i:w:f:", long_opts, nullptr)) != -1) {
+        switch (c) {
+            case 'h':
+                print_help(cf);
+                return true;
+            case 'l':
+                print_transports();
+                return true;
+            case 'm':
+                cf.model = optarg;
+                break;
+            case 't':
+                n_workers = std::atoi(optarg);
+                break;
+            case 'x':
+                {
+                    bool found = false;
+                    for (const auto& t : TRANSPORTS) {
+                        if (std::strcmp(optarg, t.name) == 0) {
+                            cf.tr = t.tr;
+                            found = true;
+                        }
+                    }
+
+                    if (!found) {
+                        std::cout << "Error: unknown transport \"" << optarg << "\", available ones are:\n";
+                        print_transports();
+                        return true;
+                    }
+                    break;
+                }
+            case 'W':
+                {
+                    bool found = false;
+                    for (const auto& wt : WAITS) {
+                        if (std::strcmp(optarg, wt.name) == 0) {
+                            cf.wait = wt.kind;
+                            found = true;
+                        }
+                    }
+
+                    if (!found) {
+                        std::cout << "Error: unknown wait strategy \"" << optarg << "\", available ones are:\n";
+                        print_transports();
+                        return true;
+                    }
+                    break;
+                }
+            case 's':
+                {
+                    const std::string range(optarg);
+                    const size_t sep = range.find(':');
+                    min_len = parse_size(range.substr(0, sep));
+                    max_len = (sep == std::string::npos) ? min_len : parse_size(range.substr(sep + 1));
+
+                    if ((min_len == 0) || (max_len < min_len) || (max_len > max_bytes)) {
+                        std::cout << "Error: bad message size range " << range
+                                  << ", sizes must be within [4, " << max_bytes << "]\n";
+                        return true;
+                    }
+                    break;
+                }
+            case 'i':
+                cf.iters = std::atol(optarg);
+                break;
+            case 'w':
+                cf.warm_up = std::atol(optarg);
+                break;
+            case 'f':
+                if (!reporter::parse_format(optarg, cf.fmt)) {
+                    std::cout << "Error: unknown output format \"" << optarg << "\"\n";
+                    return true;
+                }
+                break;
+            default:
+                print_help(cf);
+                return true;
+        }
+    }
+
+    // Keep accepting the number of workers as the only positional argument
+    if (optind < argc) {
+        n_workers = std::atoi(argv[optind]);
+    }
+
+    if (n_workers == 0) {
+        std::cout << "Error: need at least one worker per node\n";
+        return true;
+    }
+
+    // Powers of two within the range, a message has at least the ball
+    for (size_t sz = sizeof(uint32_t); sz <= max_len; sz *= 2) {
+        if (sz >= min_len) {
+            cf.sizes.push_back(sz);
+        }
+    }
+
+    if (cf.sizes.empty()) {
+        std::cout << "Error: no power of two of at least 4 bytes in the message size range\n";
+        return true;
+    }
+
+    return false;
+}
+
+
+int main(int argc, char** argv)
+{
+    config cf;
+
+    cf.model   = "threads";
+    cf.tr      = transport::Put;
+    cf.wait    = wait_kind::Spin;
+    cf.iters   = 0;
+    cf.warm_up = -1;
+    cf.fmt     = reporter::format::Table;
+
+    size_t n_workers = 1;
+
+    // Exit in case anything goes wrong
+    if (parse_args(argc, argv, cf, n_workers)) {
+        return 1;
+    }
+
+    timer::init();
+    reporter::init("pingpong", cf.fmt);
+
+    if (cf.model == "pure") {
+        run_pingpong<pure_model>(cf, n_workers);
+    } else if (cf.model == "threads") {
+        run_pingpong<thread_model<ctx_kind::Default>>(cf, n_workers);
+    } else if (cf.model == "ctx") {
+        run_pingpong<thread_model<ctx_kind::Private>>(cf, n_workers);
+    } else if (cf.model == "shared_ctx") {
+        run_pingpong<thread_model<ctx_kind::Shared>>(cf, n_workers);
+    } else {
+        std::cout << "Error: unknown execution model \"" << cf.model << "\"\n";
+        print_help(cf);
+        return 1;
+    }
+}
@@ -0,0 +1,364 @@
+// Result output shared by all the benchmarks
+//
+// A result is a record, a flat list of named fields, handed to reporter::emit.
+// The format is picked once with reporter::init (--format on the command line):
+//   table: fixed-width columns, with a header line whenever the columns change,
+//          for reading the results in a terminal
+//   json:  one JSON object per line, with the program name, a timestamp, the run
+//          configuration set with reporter::set and all the fields of the record
+//   csv:   the same fields as json, with a header line whenever the columns
+//          change, the per-worker arrays are space-separated lists
+// The per-worker arrays and the run configuration are left out of tables, a
+// change of the configuration starts a new table.
+//
+// Banners and progress messages go through reporter::text(), which drops them
+// unless the format is table, so that json and csv can be fed to other tools
+// as is. Only the reporter PE should call emit and text.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+class record {
+public:
+    record& add(const char* key, const std::string& v)
+    {
+        fields.push_back({key, quote(v), v, v, true});
+        return *this;
+    }
+
+    record& add(const char* key, const char* v)
+    {
+        return add(key, std::string(v));
+    }
+
+    record& add(const char* key, const bool v)
+    {
+        const char* s = v ? "true" : "false";
+        fields.push_back({key, s, s, s, true});
+        return *this;
+    }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    record& add(const char* key, const T v)
+    {
+        const std::string s = std::to_string(v);
+        fields.push_back({key, s, s, s, true});
+        return *this;
+    }
+
+    // Digits after the decimal point in tables, json and csv get all of them
+    record& add(const char* key, const double v, const int precision = 3)
+    {
+        std::ostringstream txt;
+        txt << std::fixed << std::setprecision(precision) << v;
+
+        fields.push_back({key, number(v), txt.str(), csv_number(v), true});
+        return *this;
+    }
+
+    // One value per worker, not shown in tables
+    record& add(const char* key, const std::vector<double>& v)
+    {
+        std::string json = "[";
+        std::string csv;
+
+        for (size_t i = 0; i < v.size(); i++) {
+            json += (i == 0 ? "" : ",") + number(v[i]);
+            csv  += (i == 0 ? "" : " ") + csv_number(v[i]);
+        }
+
+        fields.push_back({key, json + "]", "", csv, false});
+        return *this;
+    }
+
+private:
+    friend class reporter;
+
+    struct field {
+        std::string key;
+        // The value as a JSON literal, in tables and in csv
+        std::string json, text, csv;
+        bool in_table;
+    };
+
+    std::vector<field> fields;
+
+    // NaN and infinities are not JSON numbers, they are null in json and empty
+    // in csv
+    static std::string number(const double v)
+    {
+        if (!std::isfinite(v)) {
+            return "null";
+        }
+
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.9g", v);
+        return buf;
+    }
+
+    static std::string csv_number(const double v)
+    {
+        return std::isfinite(v) ? number(v) : "";
+    }
+
+    static std::string quote(const std::string& s)
+    {
+        std::string q = "\"";
+
+        for (const char c : s) {
+            if ((c == '"') || (c == '\\')) {
+                q += '\\';
+            }
+            q += c;
+        }
+
+        return q + '"';
+    }
+};
+
+
+class reporter {
+public:
+    enum class format {
+        Table,
+        Json,
+        Csv
+    };
+
+    // Returns false if the name of the format is unknown
+    static bool parse_format(const char* name, format& fmt)
+    {
+        if (std::strcmp(name, "table") == 0) {
+            fmt = format::Table;
+        } else if (std::strcmp(name, "json") == 0) {
+            fmt = format::Json;
+        } else if (std::strcmp(name, "csv") == 0) {
+            fmt = format::Csv;
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    static void init(const char* program, const format fmt)
+    {
+        state& st = get();
+
+        st.program = program;
+        st.fmt     = fmt;
+        st.conf    = record();
+        st.columns.clear();
+    }
+
+    // Add a field of the run configuration to all the following records, or
+    // change its value, tables start over with a new header
+    template <typename T>
+    static void set(const char* key, const T& v)
+    {
+        state& st = get();
+
+        record r;
+        r.add(key, v);
+
+        bool found = false;
+        for (auto& f : st.conf.fields) {
+            if (f.key == key) {
+                f = r.fields[0];
+                found = true;
+            }
+        }
+
+        if (!found) {
+            st.conf.fields.push_back(r.fields[0]);
+        }
+
+        if (st.fmt == format::Table) {
+            st.columns.clear();
+        }
+    }
+
+    static void emit(const record& r)
+    {
+        state& st = get();
+
+        switch (st.fmt) {
+            case format::Table:
+                emit_table(r);
+                break;
+            case format::Json:
+                emit_json(r);
+                break;
+            case format::Csv:
+                emit_csv(r);
+                break;
+        }
+
+        std::cout.flush();
+    }
+
+    // Stream for free text, a no-op unless the format is table
+    static std::ostream& text()
+    {
+        static std::ostream null(nullptr);
+
+        return (get().fmt == format::Table) ? std::cout : null;
+    }
+
+private:
+    struct state {
+        std::string program;
+        format fmt;
+        record conf;
+        // Keys of the last header that was printed
+        std::vector<std::string> columns;
+    };
+
+    static state& get()
+    {
+        static state st;
+        return st;
+    }
+
+    // UTC wall-clock time in ISO 8601, with milliseconds
+    static std::string timestamp()
+    {
+        using namespace std::chrono;
+
+        const auto now = system_clock::now();
+        const std::time_t t = system_clock::to_time_t(now);
+        const long ms = duration_cast<milliseconds>(now.time_since_epoch()).count() % 1000;
+
+        std::tm tm;
+        gmtime_r(&t, &tm);
+
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+        std::snprintf(buf + 19, sizeof(buf) - 19, ".%03ldZ", ms);
+
+        return buf;
+    }
+
+    // Print the header if the keys differ from the ones of the last header
+    static bool new_columns(const std::vector<std::string>& keys)
+    {
+        state& st = get();
+
+        if (keys == st.columns) {
+            return false;
+        }
+
+        st.columns = keys;
+        return true;
+    }
+
+    static void emit_table(const record& r)
+    {
+        std::vector<const record::field*> cols;
+        std::vector<std::string> keys;
+
+        for (const auto& f : r.fields) {
+            if (f.in_table) {
+                cols.push_back(&f);
+                keys.push_back(f.key);
+            }
+        }
+
+        // The first column is left-aligned like the sizes used to be
+        auto width = [](const std::string& key) {
+            return std::max<size_t>(12, key.size() + 4);
+        };
+
+        if (new_columns(keys)) {
+            for (size_t i = 0; i < cols.size(); i++) {
+                std::cout << std::setw(width(cols[i]->key)) << (i == 0 ? std::left : std::right)
+                          << cols[i]->key;
+            }
+            std::cout << '\n';
+        }
+
+        for (size_t i = 0; i < cols.size(); i++) {
+            std::cout << std::setw(width(cols[i]->key)) << (i == 0 ? std::left : std::right)
+                      << cols[i]->text;
+        }
+        std::cout << '\n';
+    }
+
+    // The program, the timestamp, the configuration, then the record
+    static std::vector<record::field> all_fields(const record& r)
+    {
+        const state& st = get();
+
+        record head;
+        head.add("program", st.program);
+        head.add("timestamp", timestamp());
+
+        std::vector<record::field> all = head.fields;
+        all.insert(all.end(), st.conf.fields.begin(), st.conf.fields.end());
+        all.insert(all.end(), r.fields.begin(), r.fields.end());
+
+        return all;
+    }
+
+    static void emit_json(const record& r)
+    {
+        const auto all = all_fields(r);
+
+        std::cout << '{';
+        for (size_t i = 0; i < all.size(); i++) {
+            std::cout << (i == 0 ? "" : ",") << record::quote(all[i].key) << ':' << all[i].json;
+        }
+        std::cout << "}\n";
+    }
+
+    static void emit_csv(const record& r)
+    {
+        const auto all = all_fields(r);
+
+        std::vector<std::string> keys;
+        for (const auto& f : all) {
+            keys.push_back(f.key);
+        }
+
+        if (new_columns(keys)) {
+            for (size_t i = 0; i < keys.size(); i++) {
+                std::cout << (i == 0 ? "" : ",") << keys[i];
+            }
+            std::cout << '\n';
+        }
+
+        // Quote the text that could break the line apart
+        for (size_t i = 0; i < all.size(); i++) {
+            const std::string& v = all[i].csv;
+
+            std::cout << (i == 0 ? "" : ",");
+
+            if (v.find_first_of(",\" ") != std::string::npos) {
+                std::cout << '"';
+                for (const char c : v) {
+                    std::cout << c;
+                    if (c == '"') {
+                        std::cout << '"';
+                    }
+                }
+                std::cout << '"';
+            } else {
+                std::cout << v;
+            }
+        }
+        std::cout << '\n';
+    }
+};
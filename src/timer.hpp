@@ -0,0 +1,157 @@
+// Low-overhead timer for the timing loops of the benchmarks
+//
+// On x86 with an invariant TSC the time stamp counter is read directly (rdtscp,
+// or lfence + rdtsc when rdtscp is missing, fenced so the read neither moves up
+// nor lets later instructions start early) and converted to time with a ratio
+// calibrated once against CLOCK_MONOTONIC. Everywhere else, or when compiled
+// with -DUSE_CLOCK_MONOTONIC, the timer falls back to clock_gettime.
+//
+// Call timer::init() once in main before any thread is spawned. Differences of
+// timer::now() are converted with timer::ns/us/ms/s.
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(USE_CLOCK_MONOTONIC)
+#define TIMER_HAVE_TSC
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+
+class timer {
+public:
+    using ticks = uint64_t;
+
+    // Pick the time source and calibrate the TSC, takes about 20 ms
+    static void init()
+    {
+        state& st = get();
+
+        st.use_tsc     = false;
+        st.use_rdtscp  = false;
+        st.ns_per_tick = 1.0;
+
+#ifdef TIMER_HAVE_TSC
+        unsigned eax, ebx, ecx, edx;
+
+        // Only an invariant TSC ticks at a constant rate on all the cores
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1U << 8))) {
+            return;
+        }
+
+        if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) && (edx & (1U << 27))) {
+            st.use_rdtscp = true;
+        }
+
+        // Sample both clocks at the start and the end of a busy wait, each TSC
+        // read is the middle of the two reads around clock_gettime
+        uint64_t ns0, ns1;
+        ticks tsc0, tsc1;
+
+        sample(ns0, tsc0);
+
+        do {
+            sample(ns1, tsc1);
+        } while (ns1 - ns0 < 20000000UL);
+
+        st.ns_per_tick = double(ns1 - ns0) / double(tsc1 - tsc0);
+        st.use_tsc = true;
+#endif
+    }
+
+    static ticks now()
+    {
+#ifdef TIMER_HAVE_TSC
+        const state& st = get();
+
+        if (st.use_tsc) {
+            return read_tsc(st.use_rdtscp);
+        }
+#endif
+        return monotonic_ns();
+    }
+
+    static double ns(const ticks t)
+    {
+        const state& st = get();
+        return st.use_tsc ? t * st.ns_per_tick : double(t);
+    }
+
+    static double us(const ticks t)
+    {
+        return ns(t) / 1000.0;
+    }
+
+    static double ms(const ticks t)
+    {
+        return ns(t) / 1000000.0;
+    }
+
+    static double s(const ticks t)
+    {
+        return ns(t) / 1000000000.0;
+    }
+
+    // Name of the time source, for the reports
+    static const char* source()
+    {
+        return get().use_tsc ? "tsc" : "clock_monotonic";
+    }
+
+    // TSC frequency in GHz, or 0 when the TSC is not used
+    static double tsc_ghz()
+    {
+        return get().use_tsc ? 1.0 / get().ns_per_tick : 0.0;
+    }
+
+private:
+    // Zero-initialized before main, so reading it never needs a guard and the
+    // timer works as CLOCK_MONOTONIC until init() is called
+    struct state {
+        bool use_tsc, use_rdtscp;
+        double ns_per_tick;
+    };
+
+    static state& get()
+    {
+        static state st;
+        return st;
+    }
+
+    static uint64_t monotonic_ns()
+    {
+        timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return t.tv_sec * 1000000000UL + t.tv_nsec;
+    }
+
+#ifdef TIMER_HAVE_TSC
+    static ticks read_tsc(const bool rdtscp)
+    {
+        ticks t;
+
+        if (rdtscp) {
+            unsigned aux;
+            t = __rdtscp(&aux);
+        } else {
+            _mm_lfence();
+            t = __rdtsc();
+        }
+
+        _mm_lfence();
+
+        return t;
+    }
+
+    static void sample(uint64_t& ns, ticks& tsc)
+    {
+        const ticks t0 = read_tsc(get().use_rdtscp);
+        ns = monotonic_ns();
+        const ticks t1 = read_tsc(get().use_rdtscp);
+
+        tsc = t0 + (t1 - t0) / 2;
+    }
+#endif
+};
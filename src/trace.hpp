@@ -0,0 +1,171 @@
+// Per-thread tracing of the communication calls of a benchmark
+//
+// Every thread records into its own ring buffer, without locks, and only the
+// last CAPACITY events are kept. An event is one call: what it was, when it
+// started and ended, which PE it targeted, the iteration and the bytes moved.
+// Recording costs two timer reads and a store into the ring.
+//
+// Each PE dumps the rings of its threads into one binary file, in host byte
+// order:
+//   trace_file_header
+//   for every thread: trace_thread_header, then n_events trace_event
+// The times are nanoseconds since an origin taken by every PE right after a
+// barrier, so the PEs line up to within the skew of the barrier.
+// trace2chrome.cpp converts the files into the JSON of the Chrome trace event
+// format, for chrome://tracing or Perfetto.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "timer.hpp"
+
+
+enum class trace_kind : uint8_t {
+    FetchAdd,
+    Put,
+    Quiet,
+    Wait
+};
+
+inline const char* trace_kind_name(const trace_kind k)
+{
+    switch (k) {
+        case trace_kind::FetchAdd:
+            return "fetch_add";
+        case trace_kind::Put:
+            return "put";
+        case trace_kind::Quiet:
+            return "quiet";
+        default:
+            return "wait";
+    }
+}
+
+
+// "TRACE001"
+#define TRACE_MAGIC 0x3130304543415254UL
+
+// The target of the calls that complete the operations to all the PEs
+#define TRACE_ALL_PES 0xffffffffU
+
+struct trace_file_header {
+    uint64_t magic;
+    uint32_t pe, n_pes, n_threads, pad;
+};
+
+struct trace_thread_header {
+    uint32_t tid, pad;
+    // Events in the file, and the older ones that the ring dropped
+    uint64_t n_events, n_dropped;
+};
+
+struct trace_event {
+    uint64_t start_ns;
+    uint32_t dur_ns;
+    uint32_t pe;
+    uint32_t iter;
+    uint32_t bytes;
+    trace_kind kind;
+    uint8_t pad[7];
+};
+
+static_assert(sizeof(trace_event) == 32, "trace_event is written as is");
+
+
+class trace_ring {
+public:
+    static const size_t CAPACITY = 1UL << 16;
+
+    trace_ring() : events(CAPACITY), n(0) {}
+
+    void record(const trace_kind kind, const timer::ticks t0, const timer::ticks t1,
+                const size_t pe, const size_t iter, const size_t bytes)
+    {
+        raw_event& e = events[n % CAPACITY];
+
+        e.t0    = t0;
+        e.t1    = t1;
+        e.pe    = uint32_t(pe);
+        e.iter  = uint32_t(iter);
+        e.bytes = uint32_t(bytes);
+        e.kind  = kind;
+
+        n++;
+    }
+
+    // Write the header and the kept events of thread tid, oldest first
+    bool write(FILE* f, const uint32_t tid, const timer::ticks origin) const
+    {
+        const uint64_t kept = (n < CAPACITY) ? n : CAPACITY;
+
+        trace_thread_header h = {};
+        h.tid       = tid;
+        h.n_events  = kept;
+        h.n_dropped = n - kept;
+
+        if (std::fwrite(&h, sizeof(h), 1, f) != 1) {
+            return false;
+        }
+
+        for (uint64_t k = n - kept; k < n; k++) {
+            const raw_event& r = events[k % CAPACITY];
+
+            trace_event e = {};
+            e.start_ns = uint64_t(timer::ns(r.t0 - origin));
+            e.dur_ns   = uint32_t(timer::ns(r.t1 - r.t0));
+            e.pe       = r.pe;
+            e.iter     = r.iter;
+            e.bytes    = r.bytes;
+            e.kind     = r.kind;
+
+            if (std::fwrite(&e, sizeof(e), 1, f) != 1) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+private:
+    // The times stay in ticks until the dump
+    struct raw_event {
+        timer::ticks t0, t1;
+        uint32_t pe, iter, bytes;
+        trace_kind kind;
+    };
+
+    std::vector<raw_event> events;
+    uint64_t n;
+    // The rings sit next to each other in a vector, whose allocator doesn't
+    // have to honor an over-alignment before C++17, so a cache line of
+    // padding keeps n off the line of the next ring
+    char pad[64];
+};
+
+
+// Dump the rings of all the threads of PE pe into path
+// Returns false if the file can't be written
+inline bool write_trace(const char* path, const uint32_t pe, const uint32_t n_pes,
+                        const std::vector<trace_ring>& rings, const timer::ticks origin)
+{
+    FILE* f = std::fopen(path, "wb");
+    if (f == nullptr) {
+        return false;
+    }
+
+    trace_file_header h = {};
+    h.magic     = TRACE_MAGIC;
+    h.pe        = pe;
+    h.n_pes     = n_pes;
+    h.n_threads = uint32_t(rings.size());
+
+    bool ok = (std::fwrite(&h, sizeof(h), 1, f) == 1);
+
+    for (size_t t = 0; ok && (t < rings.size()); t++) {
+        ok = rings[t].write(f, uint32_t(t), origin);
+    }
+
+    return (std::fclose(f) == 0) && ok;
+}
@@ -0,0 +1,97 @@
+// Convert the binary traces of the benchmarks (see trace.hpp) into the JSON of
+// the Chrome trace event format, to look at them with chrome://tracing or
+// Perfetto
+//
+//   g++ -std=c++14 -O2 trace2chrome.cpp -o trace2chrome
+//   ./trace2chrome isx_trace.*.bin > isx_trace.json
+//
+// Every PE shows up as a process and every thread as a thread of it. A call is
+// a complete event, with the target PE, the iteration and the bytes in its
+// arguments.
+#include <cstdio>
+#include <iostream>
+
+#include "trace.hpp"
+
+
+// Returns false if the file is not a trace or is cut short
+bool convert(const char* path, bool& first)
+{
+    FILE* f = std::fopen(path, "rb");
+    if (f == nullptr) {
+        return false;
+    }
+
+    trace_file_header h;
+    bool ok = (std::fread(&h, sizeof(h), 1, f) == 1) && (h.magic == TRACE_MAGIC);
+
+    if (ok) {
+        std::cout << (first ? "" : ",\n")
+                  << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << h.pe
+                  << ",\"args\":{\"name\":\"PE " << h.pe << "\"}}";
+        first = false;
+    }
+
+    for (uint32_t t = 0; ok && (t < h.n_threads); t++) {
+        trace_thread_header th;
+        ok = (std::fread(&th, sizeof(th), 1, f) == 1);
+
+        if (ok && (th.n_dropped > 0)) {
+            std::cerr << path << ": thread " << th.tid << " dropped its " << th.n_dropped
+                      << " oldest events\n";
+        }
+
+        for (uint64_t k = 0; ok && (k < th.n_events); k++) {
+            trace_event e;
+            ok = (std::fread(&e, sizeof(e), 1, f) == 1);
+
+            if (!ok) {
+                break;
+            }
+
+            char buf[256];
+            std::snprintf(buf, sizeof(buf),
+                          ",\n{\"name\":\"%s\",\"cat\":\"comm\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+                          "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"pe\":",
+                          trace_kind_name(e.kind), h.pe, th.tid, e.start_ns / 1000.0, e.dur_ns / 1000.0);
+            std::cout << buf;
+
+            if (e.pe == TRACE_ALL_PES) {
+                std::cout << "\"all\"";
+            } else {
+                std::cout << e.pe;
+            }
+
+            std::cout << ",\"iter\":" << e.iter << ",\"bytes\":" << e.bytes << "}}";
+        }
+    }
+
+    std::fclose(f);
+
+    return ok;
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <trace files...>\n";
+        return 1;
+    }
+
+    bool first = true;
+    int ret = 0;
+
+    std::cout << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+    for (int i = 1; i < argc; i++) {
+        if (!convert(argv[i], first)) {
+            std::cerr << "Error: " << argv[i] << " is not a complete trace\n";
+            ret = 1;
+        }
+    }
+
+    std::cout << "\n]}\n";
+
+    return ret;
+}
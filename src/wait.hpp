@@ -0,0 +1,142 @@
+// Strategies for waiting until a symmetric word, updated by another PE, reaches
+// a value
+//
+//   spin:       busy-poll an acquire load, with a pause between polls
+//   wait_until: shmem_wait_until, however the library implements it
+//   test:       busy-poll shmem_test, with a pause between polls
+//   yield:      sched_yield between polls (what the ping-pong used to do)
+//   spin_yield: spin for a while, then sched_yield between polls
+//   backoff:    spin for a while, then sleep between polls, doubling the sleep
+//               up to BACKOFF_MAX_NS
+//
+// A real futex can't be used for the last one, since a remote put doesn't wake
+// anybody up, so the backoff sleeps for a bounded time instead.
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+#include <sched.h>
+#include <shmem.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+
+enum class wait_kind {
+    Spin,
+    WaitUntil,
+    Test,
+    Yield,
+    SpinYield,
+    Backoff
+};
+
+
+struct wait_entry {
+    const char* name;
+    wait_kind kind;
+    const char* desc;
+};
+
+const wait_entry WAITS[] = {
+    {"spin",       wait_kind::Spin,      "busy-poll an atomic load with pause"},
+    {"wait_until", wait_kind::WaitUntil, "shmem_wait_until"},
+    {"test",       wait_kind::Test,      "busy-poll shmem_test with pause"},
+    {"yield",      wait_kind::Yield,     "sched_yield between polls"},
+    {"spin_yield", wait_kind::SpinYield, "spin, then sched_yield between polls"},
+    {"backoff",    wait_kind::Backoff,   "spin, then sleep with exponential backoff"},
+};
+
+
+// Number of polls before the hybrid strategies give the core away
+#define SPIN_POLLS 4096
+
+#define BACKOFF_MIN_NS 1000
+#define BACKOFF_MAX_NS 64000
+
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+
+// Typed shmem_wait_until and shmem_test for equality
+inline void shmem_wait_eq(uint32_t* addr, const uint32_t value)
+{
+    shmem_uint32_wait_until(addr, SHMEM_CMP_EQ, value);
+}
+
+inline void shmem_wait_eq(uint64_t* addr, const uint64_t value)
+{
+    shmem_uint64_wait_until(addr, SHMEM_CMP_EQ, value);
+}
+
+inline bool shmem_test_eq(uint32_t* addr, const uint32_t value)
+{
+    return shmem_uint32_test(addr, SHMEM_CMP_EQ, value);
+}
+
+inline bool shmem_test_eq(uint64_t* addr, const uint64_t value)
+{
+    return shmem_uint64_test(addr, SHMEM_CMP_EQ, value);
+}
+
+
+// Return when *addr == value
+template <typename T>
+void wait_for(const wait_kind kind, T* addr, const T value)
+{
+    size_t polls = 0;
+    long sleep_ns = BACKOFF_MIN_NS;
+
+    switch (kind) {
+        case wait_kind::Spin:
+            while (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != value) {
+                cpu_relax();
+            }
+            break;
+        case wait_kind::WaitUntil:
+            shmem_wait_eq(addr, value);
+            break;
+        case wait_kind::Test:
+            while (!shmem_test_eq(addr, value)) {
+                cpu_relax();
+            }
+            break;
+        case wait_kind::Yield:
+            while (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != value) {
+                sched_yield();
+            }
+            break;
+        case wait_kind::SpinYield:
+            while (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != value) {
+                if (polls < SPIN_POLLS) {
+                    polls++;
+                    cpu_relax();
+                } else {
+                    sched_yield();
+                }
+            }
+            break;
+        case wait_kind::Backoff:
+            while (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != value) {
+                if (polls < SPIN_POLLS) {
+                    polls++;
+                    cpu_relax();
+                } else {
+                    const timespec ts = {0, sleep_ns};
+                    nanosleep(&ts, nullptr);
+
+                    if (sleep_ns < BACKOFF_MAX_NS) {
+                        sleep_ns *= 2;
+                    }
+                }
+            }
+            break;
+    }
+}